@@ -0,0 +1,240 @@
+/**
+ * acquisition.c - Interrupt-driven ADC sampling
+ *
+ * Producer: acquisition_isr(), called from handle_interrupt() on every
+ * timer tick. It does one DRDY check and, if a conversion is waiting,
+ * reads it and appends it to the ring.
+ *
+ * Consumer: the main loop, through acquisition_pop_batch_tagged().
+ *
+ * head is only written by the producer and tail only by the consumer.
+ * Both are free-running counters; the slot index is the counter masked
+ * by the buffer size, and head - tail is the fill level even across
+ * wrap-around. The compiler barrier orders the data access against the
+ * index update, which is all a single in-order core needs.
+ *
+ * Two more rings hold each sample's cycle stamp and channel under the
+ * same indices. Popping a sample feeds its stamp to its channel's
+ * timebase estimator, which runs entirely on the consumer side.
+ */
+
+#include "acquisition.h"
+#include "ad7705_driver.h"
+#include "timer.h"
+#include "hal.h"
+#include "lib.h"
+
+#define ACQ_MASK            (ACQ_BUFFER_SIZE - 1)
+#define barrier()           __asm__ volatile ("" ::: "memory")
+
+static uint16_t ring[ACQ_BUFFER_SIZE];
+static volatile uint32_t head;      // Next slot to write (producer)
+static volatile uint32_t tail;      // Next slot to read (consumer)
+static volatile uint32_t overruns;  // Samples dropped because the ring was full
+static uint32_t stamps[ACQ_BUFFER_SIZE];  // Cycle count when each sample was read
+static uint8_t channels[ACQ_BUFFER_SIZE];  // Channel each sample came from
+
+// Timebase estimator per channel (consumer)
+typedef struct {
+    bool primed;            // last is valid
+    uint32_t last;          // Stamp of the previous sample
+    uint32_t mark;          // Stamp that opened the rate window
+    uint32_t count;         // Intervals in the rate window
+    int32_t interval_q8;    // Rolling mean interval, cycles Q8
+    int32_t jitter_q8;      // Rolling mean absolute deviation, cycles Q8
+    uint32_t win_min, win_max;
+    acq_timebase_t result;
+} timebase_t;
+
+static timebase_t timebases[ACQ_CHANNELS];
+
+// Scheduler (producer)
+static uint8_t acq_channel;         // Channel being converted
+static bool acq_dual;               // Alternate between both channels
+static int acq_block;               // Conversions per channel before switching
+static int block_count;             // Conversions taken on acq_channel so far
+static volatile uint32_t switches;  // Channel switches
+
+/**
+ * Timebase estimator, fed with every popped stamp of one channel. The
+ * rate is counted over whole windows of ACQ_RATE_WINDOW intervals, first
+ * to last stamp, so the timer tick quantisation of a single stamp costs
+ * one tick per window. The interval and its deviation are rolling
+ * averages, and samples lost to overruns show up as long intervals.
+ */
+static void track(timebase_t *tb, uint32_t stamp) {
+    if (!tb->primed) {
+        tb->primed = true;
+        tb->last = tb->mark = stamp;
+        tb->count = 0;
+        tb->interval_q8 = 0;
+        tb->jitter_q8 = 0;
+        tb->win_min = UINT32_MAX;
+        tb->win_max = 0;
+        return;
+    }
+
+    uint32_t d = stamp - tb->last;
+    tb->last = stamp;
+    if (d > 0x7FFFFF) d = 0x7FFFFF;     // Keep the Q8 math in range
+
+    if (tb->interval_q8 == 0) tb->interval_q8 = (int32_t)(d << 8);
+    int32_t err = (int32_t)(d << 8) - tb->interval_q8;
+    tb->interval_q8 += err >> ACQ_INTERVAL_SHIFT;
+    int32_t dev = err < 0 ? -err : err;
+    tb->jitter_q8 += (dev - tb->jitter_q8) >> ACQ_INTERVAL_SHIFT;
+
+    if (d < tb->win_min) tb->win_min = d;
+    if (d > tb->win_max) tb->win_max = d;
+
+    if (++tb->count >= ACQ_RATE_WINDOW) {
+        uint32_t elapsed = stamp - tb->mark;
+        tb->result.rate_mhz = (uint32_t)((uint64_t)tb->count * SYSTEM_CLOCK_FREQ * 1000 / elapsed);
+        tb->result.interval_min = tb->win_min;
+        tb->result.interval_max = tb->win_max;
+        tb->mark = stamp;
+        tb->count = 0;
+        tb->win_min = UINT32_MAX;
+        tb->win_max = 0;
+    }
+}
+
+static void reset(uint8_t channel, bool dual, int block) {
+    acq_channel = channel;
+    acq_dual = dual;
+    acq_block = block > 0 ? block : 1;
+    block_count = 0;
+    head = 0;
+    tail = 0;
+    overruns = 0;
+    switches = 0;
+    for (int ch = 0; ch < ACQ_CHANNELS; ch++) {
+        timebases[ch].primed = false;
+        timebases[ch].result = (acq_timebase_t){0};
+    }
+}
+
+static void start_timer(int tick_hz) {
+    timer_init(tick_hz);
+    timer_enable_interrupt();
+    enable_interrupt();
+}
+
+/**
+ * Start sampling: the timer ticks at tick_hz and every tick checks for a
+ * new conversion. tick_hz should be above the ADC update rate so each
+ * conversion is picked up before the next one replaces it.
+ */
+void acquisition_start(uint8_t channel, int tick_hz) {
+    reset(channel, false, 1);
+    start_timer(tick_hz);
+}
+
+/**
+ * Start sampling AIN1 and AIN2 in turn, block conversions each. Both
+ * calibration pairs must have been calibrated, and the part must be
+ * converting on AIN1.
+ *
+ * Each switch costs the filter settling time, so a larger block gives
+ * more samples per second overall but bunches them: block 1 spaces each
+ * channel's samples evenly at a seventh of the single-channel rate:
+ * three updates of settling after each switch plus half an update until
+ * the next poll finds the result, twice per round (71 S/s at 500 Hz).
+ */
+void acquisition_start_dual(int tick_hz, int block) {
+    reset(CHN_AIN1, true, block);
+    start_timer(tick_hz);
+}
+
+/**
+ * The switch to the other channel is requested in the same SPI frame as
+ * the last read of a block, so the filter starts settling on the new
+ * channel right away and no tick is spent on a separate setup write.
+ */
+void acquisition_isr(void) {
+    uint8_t channel = acq_channel;
+    uint8_t next = channel;
+    if (acq_dual && block_count + 1 >= acq_block) {
+        next = channel ^ 1;
+    }
+
+    uint16_t sample;
+    if (!ad7705_try_read_next(channel, next, &sample)) {
+        return;
+    }
+    uint32_t now = hal_read_cycles();
+
+    if (next != channel) {
+        acq_channel = next;
+        block_count = 0;
+        switches++;
+    } else {
+        block_count++;
+    }
+
+    uint32_t h = head;
+    if (h - tail >= ACQ_BUFFER_SIZE) {
+        overruns++;
+        return;
+    }
+    ring[h & ACQ_MASK] = sample;
+    stamps[h & ACQ_MASK] = now;
+    channels[h & ACQ_MASK] = channel;
+    barrier();
+    head = h + 1;
+}
+
+/**
+ * Take up to max samples in one go, returns how many were copied. Each
+ * sample's cycle stamp and channel are copied too when stamps and
+ * channels are not null.
+ */
+int acquisition_pop_batch_tagged(uint16_t *samples, uint32_t *stamps_out,
+                                 uint8_t *channels_out, int max) {
+    uint32_t t = tail;
+    uint32_t available = head - t;
+    int n = available < (uint32_t)max ? (int)available : max;
+
+    barrier();
+    for (int i = 0; i < n; i++) {
+        uint32_t slot = (t + i) & ACQ_MASK;
+        samples[i] = ring[slot];
+        track(&timebases[channels[slot]], stamps[slot]);
+        if (stamps_out) stamps_out[i] = stamps[slot];
+        if (channels_out) channels_out[i] = channels[slot];
+    }
+    barrier();
+    tail = t + n;
+    return n;
+}
+
+uint32_t acquisition_overruns(void) {
+    return overruns;
+}
+
+/**
+ * Channel switches since the start, one per block in dual mode
+ */
+uint32_t acquisition_switches(void) {
+    return switches;
+}
+
+/**
+ * Effective sample rate of one channel in mHz. Until its first window
+ * completes it is estimated from the rolling mean interval, 0 before
+ * two samples have arrived.
+ */
+uint32_t acquisition_sample_rate_mhz(uint8_t channel) {
+    const timebase_t *tb = &timebases[channel];
+    if (tb->result.rate_mhz == 0 && tb->interval_q8 > 0) {
+        return (uint32_t)(((uint64_t)SYSTEM_CLOCK_FREQ * 1000 << 8) / (uint32_t)tb->interval_q8);
+    }
+    return tb->result.rate_mhz;
+}
+
+void acquisition_get_timebase(uint8_t channel, acq_timebase_t *out) {
+    const timebase_t *tb = &timebases[channel];
+    *out = tb->result;
+    out->interval_cycles = (uint32_t)(tb->interval_q8 >> 8);
+    out->jitter_cycles = (uint32_t)(tb->jitter_q8 >> 8);
+}
@@ -0,0 +1,58 @@
+/**
+ * acquisition.h - Interrupt-driven ADC sampling
+ *
+ * The timer interrupt polls the AD7705 and pushes every new conversion
+ * into a single-producer/single-consumer ring buffer. The main loop is
+ * the only consumer and drains it at its own pace, so slow rendering no
+ * longer costs conversions as long as the buffer does not fill up.
+ *
+ * Every sample is stamped with the cycle counter when the interrupt
+ * reads it. The consumer side turns the stamps into the effective sample
+ * rate and the spread of the sample interval, so the timebase on screen
+ * follows what is really delivered rather than the ADC's nominal rate.
+ *
+ * With acquisition_start_dual() the interrupt alternates between AIN1
+ * and AIN2. The AD7705 has one modulator, and every channel switch
+ * restarts its sinc3 filter: the first result on the new channel comes
+ * three update periods later instead of one. Taking block conversions
+ * per channel before switching spreads that cost; samples are tagged
+ * with their channel and each channel has its own timebase.
+ */
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ring buffer capacity in samples, must be a power of two
+#define ACQ_BUFFER_SIZE     256
+
+// Samples per sample-rate measurement window (~1 s at 500 S/s)
+#define ACQ_RATE_WINDOW     512
+
+// Rolling interval/jitter averages follow 1/2^n of each new interval
+#define ACQ_INTERVAL_SHIFT  4
+
+// Channels the scheduler knows, indexed by AD7705 channel number
+#define ACQ_CHANNELS        2
+
+typedef struct {
+    uint32_t rate_mhz;          // Samples delivered per 1000 s over the last window, 0 = none yet
+    uint32_t interval_cycles;   // Rolling mean sample interval
+    uint32_t jitter_cycles;     // Rolling mean deviation from it
+    uint32_t interval_min;      // Shortest and longest interval in the last window
+    uint32_t interval_max;
+} acq_timebase_t;
+
+void acquisition_start(uint8_t channel, int tick_hz);
+void acquisition_start_dual(int tick_hz, int block);
+void acquisition_isr(void);
+int acquisition_pop_batch_tagged(uint16_t *samples, uint32_t *stamps,
+                                 uint8_t *channels, int max);
+uint32_t acquisition_overruns(void);
+uint32_t acquisition_switches(void);
+uint32_t acquisition_sample_rate_mhz(uint8_t channel);
+void acquisition_get_timebase(uint8_t channel, acq_timebase_t *tb);
+
+#endif // ACQUISITION_H
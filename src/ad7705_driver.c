@@ -8,6 +8,14 @@
  * 2. Read/Write the selected register
  * 
  * DRDY pin goes low when conversion data is ready.
+ * 
+ * Two ways to wait for data (ad7705_set_drdy_mode):
+ * - DRDY_MODE_REGISTER: poll the DRDY bit of the Communication Register.
+ *   Costs a command byte plus a status byte, each in its own CS frame,
+ *   and the data read then needs a third frame.
+ * - DRDY_MODE_PIN: sample the DRDY pin on the GPIO port (no bus traffic)
+ *   and send the read command and clock out the 16-bit result in a
+ *   single CS frame: 3 bytes and one CS assertion per sample.
  */
 
 #include "ad7705_driver.h"
@@ -17,6 +25,14 @@
 #include "dtekv-lib.h"
 #include "delay.h"
 
+static uint8_t drdy_mode = DRDY_MODE_REGISTER;
+
+// Samples read, and the SPI counters when the statistics were reset
+static uint32_t sample_count;
+static uint32_t read_cycles;
+static uint32_t byte_mark;
+static uint32_t select_mark;
+
 
 /**
  * Write a single byte to the AD7705
@@ -28,7 +44,7 @@ static void write_byte(uint8_t data) {
 }
 
 /**
- * Write to the Communication Register to set up next operation
+ * Build a Communication Register byte
  * 
  * Communication Register Format (8 bits):
  * Bit 7: 0 (must be zero)
@@ -37,13 +53,19 @@ static void write_byte(uint8_t data) {
  * Bit 2: STBY (standby mode)
  * Bit 1-0: CH1-CH0 (Channel Select)
  */
+static uint8_t comm_byte(uint8_t reg, uint8_t channel, bool read) {
+    uint8_t comm = 0;
+    comm |= (reg & 0x07) << 4;      // RS2-RS0 in bits 6-4
+    comm |= (read ? 1 : 0) << 3;    // R/W in bit 3
+    comm |= (channel & 0x03);       // CH1-CH0 in bits 1-0
+    return comm;
+}
+
+/**
+ * Write to the Communication Register to set up next operation
+ */
 static void set_next_operation(uint8_t reg, uint8_t channel, bool read) {
-    uint8_t comm_byte = 0;
-    comm_byte |= (reg & 0x07) << 4;      // RS2-RS0 in bits 6-4
-    comm_byte |= (read ? 1 : 0) << 3;    // R/W in bit 3
-    comm_byte |= (channel & 0x03);       // CH1-CH0 in bits 1-0
-    
-    write_byte(comm_byte);
+    write_byte(comm_byte(reg, channel, read));
 }
 
 /**
@@ -131,6 +153,9 @@ static bool check_drdy_register(uint8_t channel) {
  * 3. Configure clock register
  * 4. Configure setup register and start self-calibration
  * 5. Wait for calibration to complete
+ *
+ * Only the given channel's calibration pair is calibrated; call
+ * ad7705_calibrate() for the other one before converting on it.
  */
 void ad7705_init(uint8_t channel) {
     display_string("AD7705 init start\n");
@@ -156,7 +181,18 @@ void ad7705_init(uint8_t channel) {
                          1,                    // CLK: 1 = MCLK > 2MHz
                          UPDATE_RATE_200);     // 200 Hz update rate
     
-    // Step 4: Configure Setup Register with Self-Calibration
+    // Step 4-5: Self-calibration
+    ad7705_calibrate(channel);
+    
+    display_string("AD7705 init complete\n");
+}
+
+/**
+ * Self-calibrate one channel's calibration pair (Offset and Gain
+ * registers) and leave the part converting on that channel
+ */
+void ad7705_calibrate(uint8_t channel) {
+    // Configure Setup Register with Self-Calibration
     // Mode = Self-Cal, Gain = 1, Unipolar, Unbuffered
     display_string("  Config setup reg + self-cal...\n");
     write_setup_register(channel,
@@ -166,7 +202,7 @@ void ad7705_init(uint8_t channel) {
                          0,                    // Unbuffered
                          0);                   // FSYNC = 0
     
-    // Step 5: Wait for self-calibration to complete
+    // Wait for self-calibration to complete
     // DRDY goes low when calibration is done
     display_string("  Waiting for calibration...\n");
     
@@ -183,8 +219,48 @@ void ad7705_init(uint8_t channel) {
     } else {
         display_string(" Calibration done!\n");
     }
+}
+
+/**
+ * Is a conversion result waiting, checked the configured way
+ */
+static bool data_ready(uint8_t channel) {
+    if (drdy_mode == DRDY_MODE_PIN) {
+        return spi_is_ready();
+    }
+    return check_drdy_register(channel);
+}
+
+/**
+ * Read the 16-bit Data Register (MSB first), caller has checked DRDY.
+ * If next differs from channel, the part is switched to next in the
+ * same CS frame: a Communication Register write to the NOP register
+ * with next's channel bits, which restarts the filter on that channel.
+ */
+static uint16_t read_data_register(uint8_t channel, uint8_t next) {
+    uint16_t data;
+    uint32_t start = cycles_now();
     
-    display_string("AD7705 init complete\n");
+    if (drdy_mode == DRDY_MODE_PIN) {
+        // Command and data in one CS frame
+        spi_select_chip();
+        spi_transfer_byte(comm_byte(REG_DATA, channel, true));
+        data = spi_transfer_word(0x0000);
+        if (next != channel) spi_transfer_byte(comm_byte(REG_NOP, next, false));
+        spi_deselect_chip();
+    } else {
+        // Set up to read Data Register
+        set_next_operation(REG_DATA, channel, true);
+        
+        spi_select_chip();
+        data = spi_transfer_word(0x0000);
+        spi_deselect_chip();
+        if (next != channel) set_next_operation(REG_NOP, next, false);
+    }
+    
+    sample_count++;
+    read_cycles += cycles_now() - start;
+    return data;
 }
 
 /**
@@ -192,20 +268,15 @@ void ad7705_init(uint8_t channel) {
  */
 uint16_t ad7705_read_data(uint8_t channel) {
     // Wait for data ready
-    while (!check_drdy_register(channel)) {
-        // Busy wait
+    if (drdy_mode == DRDY_MODE_PIN) {
+        spi_wait_for_ready();
+    } else {
+        while (!check_drdy_register(channel)) {
+            // Busy wait
+        }
     }
     
-    // Set up to read Data Register
-    set_next_operation(REG_DATA, channel, true);
-    
-    // Read 16-bit data (MSB first)
-    spi_select_chip();
-    uint8_t high_byte = spi_transfer_byte(0x00);
-    uint8_t low_byte = spi_transfer_byte(0x00);
-    spi_deselect_chip();
-    
-    return ((uint16_t)high_byte << 8) | low_byte;
+    return read_data_register(channel, channel);
 }
 
 /**
@@ -215,8 +286,8 @@ bool ad7705_read_data_timeout(uint8_t channel, uint16_t *data) {
     int timeout = 100000;
     
     while (timeout > 0) {
-        if (check_drdy_register(channel)) {
-            *data = ad7705_read_data(channel);
+        if (data_ready(channel)) {
+            *data = read_data_register(channel, channel);
             return true;
         }
         timeout--;
@@ -225,16 +296,69 @@ bool ad7705_read_data_timeout(uint8_t channel, uint16_t *data) {
 }
 
 /**
- * Convert raw ADC value to voltage
+ * Single DRDY check, read the sample only if one is waiting.
+ * Never blocks, so it is safe to call from the timer interrupt.
+ */
+bool ad7705_try_read(uint8_t channel, uint16_t *data) {
+    return ad7705_try_read_next(channel, channel, data);
+}
+
+/**
+ * As ad7705_try_read(), then switch to channel next if it differs. The
+ * next result arrives once the filter has settled on the new channel.
+ */
+bool ad7705_try_read_next(uint8_t channel, uint8_t next, uint16_t *data) {
+    if (!data_ready(channel)) {
+        return false;
+    }
+    *data = read_data_register(channel, next);
+    return true;
+}
+
+/**
+ * Select how data readiness is detected: DRDY_MODE_REGISTER or DRDY_MODE_PIN
+ */
+void ad7705_set_drdy_mode(uint8_t mode) {
+    drdy_mode = mode;
+}
+
+/**
+ * Bus cost since the last reset: samples read, and the SPI bytes, SCLK
+ * cycles and CS assertions spent on them, including DRDY polls that did
+ * not find data.
+ */
+void ad7705_get_bus_stats(ad7705_bus_stats_t *stats) {
+    uint32_t bytes = spi_get_byte_count() - byte_mark;
+    stats->samples = sample_count;
+    stats->spi_bytes = bytes;
+    stats->sclk_periods = bytes * 8;
+    stats->cs_assertions = spi_get_select_count() - select_mark;
+    stats->read_cycles = read_cycles;
+}
+
+void ad7705_reset_bus_stats(void) {
+    sample_count = 0;
+    read_cycles = 0;
+    byte_mark = spi_get_byte_count();
+    select_mark = spi_get_select_count();
+}
+
+/**
+ * Read the channel and convert to microvolts
  * 
  * For unipolar mode: Voltage = (ADC_Value / 65535) * Vref
  * For bipolar mode:  Voltage = ((ADC_Value - 32768) / 32768) * Vref
  */
-float ad7705_read_voltage(uint8_t channel) {
-    uint16_t raw = ad7705_read_data(channel);
-    
+int32_t ad7705_read_microvolts(uint8_t channel) {
     // Unipolar mode calculation
-    return (float)raw * VREF / 65535.0f;
+    return ad7705_raw_to_uv(ad7705_read_data(channel));
+}
+
+/**
+ * Float wrapper around ad7705_read_microvolts()
+ */
+float ad7705_read_voltage(uint8_t channel) {
+    return ad7705_read_microvolts(channel) / 1000000.0f;
 }
 
 
@@ -243,5 +367,5 @@ float ad7705_read_voltage(uint8_t channel) {
  * Check if data is ready without blocking
  */
 bool ad7705_data_ready(uint8_t channel) {
-    return check_drdy_register(channel);
+    return data_ready(channel);
 }
\ No newline at end of file
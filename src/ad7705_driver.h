@@ -67,16 +67,48 @@
 #define UNIPOLAR    0x1    // Unipolar operation: 0 to +Vref
 
 #define VREF        3.3f   // Reference voltage in volts
+#define VREF_MV     3300   // Same, in millivolts
+
+// Microvolts per LSB in unipolar mode (VREF / 65535), Q16
+#define AD7705_UV_PER_LSB_Q16   ((uint32_t)(((uint64_t)VREF_MV * 1000 << 16) / 65535))
+
+// Data ready detection (ad7705_set_drdy_mode)
+#define DRDY_MODE_REGISTER  0    // Poll the DRDY bit in the Communication Register
+#define DRDY_MODE_PIN       1    // Sample the DRDY pin, merged command + data frame
 
 #define WRITE_SETUP_REG   0x10    // Write to setup register, channel 0
 #define WRITE_CLOCK_REG   0x20    // Write to clock register, channel 0
 #define CLOCK_CONFIG      0x0C    // CLK=1, CLKDIV=0, update rate=0
 
 
+// Per-sample bus cost, see ad7705_get_bus_stats()
+typedef struct {
+    uint32_t samples;        // Data Register reads
+    uint32_t spi_bytes;      // Bytes on the bus, DRDY polls included
+    uint32_t sclk_periods;   // SCLK periods (8 per byte)
+    uint32_t cs_assertions;  // CS frames
+    uint32_t read_cycles;    // CPU cycles spent in Data Register reads
+} ad7705_bus_stats_t;
+
+
 void ad7705_init(uint8_t channel);
+void ad7705_calibrate(uint8_t channel);
 uint16_t ad7705_read_data(uint8_t channel);
 bool ad7705_read_data_timeout(uint8_t channel, uint16_t *data);
+bool ad7705_try_read(uint8_t channel, uint16_t *data);
+bool ad7705_try_read_next(uint8_t channel, uint8_t next, uint16_t *data);
 float ad7705_read_voltage(uint8_t channel);
+int32_t ad7705_read_microvolts(uint8_t channel);
+
+/**
+ * Unipolar raw code to microvolts (rounded), without floating point
+ */
+static inline int32_t ad7705_raw_to_uv(uint16_t raw) {
+    return (int32_t)(((uint64_t)raw * AD7705_UV_PER_LSB_Q16 + 0x8000) >> 16);
+}
 bool ad7705_data_ready(uint8_t channel);
+void ad7705_set_drdy_mode(uint8_t mode);
+void ad7705_get_bus_stats(ad7705_bus_stats_t *stats);
+void ad7705_reset_bus_stats(void);
 
 #endif // AD7705_DRIVER_H
\ No newline at end of file
@@ -0,0 +1,248 @@
+/**
+ * capture.c - Deep capture memory with a min/max decimation pyramid
+ *
+ * Level 0 is the raw ring. Levels 1..CAPTURE_DEPTH_LOG2 share one array:
+ * level k holds CAPTURE_DEPTH >> k blocks starting at
+ * CAPTURE_DEPTH - (CAPTURE_DEPTH >> (k - 1)), and the block holding
+ * position p is (p >> k) modulo that size. A level's ring covers the
+ * same CAPTURE_DEPTH samples as the raw ring, so any aligned block that
+ * lies within the last CAPTURE_DEPTH samples is still intact.
+ *
+ * Each channel has its own raw ring and pyramid; the position counter is
+ * per bank, shared by the channels.
+ *
+ * sums[p] holds the total of every sample before position p, modulo
+ * 2^32. The difference of two entries is exact as long as the true sum
+ * between them fits in 32 bits, which holds for up to 65536 samples.
+ */
+
+#include "capture.h"
+
+#define RAW_MASK            (CAPTURE_DEPTH - 1)
+#define LEVEL_BASE(k)       (CAPTURE_DEPTH - (CAPTURE_DEPTH >> ((k) - 1)))
+#define LEVEL_MASK(k)       ((CAPTURE_DEPTH >> (k)) - 1)
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+} minmax_t;
+
+typedef struct {
+    uint16_t raw[CAPTURE_DEPTH];
+    minmax_t pyramid[CAPTURE_DEPTH - 1];
+    uint32_t sums[CAPTURE_DEPTH];
+    uint32_t total;                 // Sum of every sample so far, modulo 2^32
+} trace_t;
+
+typedef struct {
+    trace_t traces[CAPTURE_CHANNELS];
+    uint32_t count;                 // Position of the next sample
+} bank_t;
+
+static bank_t banks[2];
+static uint8_t live;                // Bank samples go to
+static uint8_t shown;               // Bank the view functions read
+static uint8_t fed;                 // Bit per channel fed since the reset
+
+void capture_reset(void) {
+    live = shown = 0;
+    fed = 1;
+    banks[0].count = 0;
+}
+
+/**
+ * Copy the live bank to the other one and show the copy. The live bank
+ * keeps its history and carries on, so a later capture_thaw() resumes
+ * without a gap. The copy is one pass over both banks (2.5 MB per
+ * channel in use); the acquisition ring covers half a second of samples
+ * meanwhile.
+ */
+void capture_freeze(void) {
+    if (shown != live) return;
+    shown = live ^ 1;
+    for (int ch = 0; ch < CAPTURE_CHANNELS; ch++) {
+        if (fed & (1 << ch)) banks[shown].traces[ch] = banks[live].traces[ch];
+    }
+    banks[shown].count = banks[live].count;
+}
+
+/**
+ * Show the live bank again
+ */
+void capture_thaw(void) {
+    shown = live;
+}
+
+/**
+ * Store one sample at position n and extend the blocks containing it. A
+ * block that already spans the sample implies every larger block
+ * containing it does too, so the walk up the levels usually stops at the
+ * first one and the average cost per sample is constant.
+ */
+static void store(trace_t *t, uint32_t n, uint16_t s) {
+    t->raw[n & RAW_MASK] = s;
+    t->sums[n & RAW_MASK] = t->total;
+    t->total += s;
+    
+    for (int k = 1; k <= CAPTURE_DEPTH_LOG2; k++) {
+        minmax_t *m = &t->pyramid[LEVEL_BASE(k) + ((n >> k) & LEVEL_MASK(k))];
+        if ((n & ((1u << k) - 1)) == 0) {
+            // First sample of a new block
+            m->min = s;
+            m->max = s;
+        } else if (s < m->min) {
+            m->min = s;
+        } else if (s > m->max) {
+            m->max = s;
+        } else {
+            break;
+        }
+    }
+}
+
+/**
+ * Append a CH1 sample
+ */
+void capture_feed(uint16_t s) {
+    bank_t *b = &banks[live];
+    store(&b->traces[0], b->count++, s);
+}
+
+/**
+ * Append a CH1 sample and the CH2 sample taken alongside it. Mixing this
+ * with capture_feed() leaves CH2 gaps holding stale samples.
+ */
+void capture_feed_pair(uint16_t ch1, uint16_t ch2) {
+    bank_t *b = &banks[live];
+    uint32_t n = b->count++;
+    fed |= 1 << 1;
+    store(&b->traces[0], n, ch1);
+    store(&b->traces[1], n, ch2);
+}
+
+/**
+ * Store the math sample for the position last fed
+ */
+void capture_feed_math(uint16_t m) {
+    bank_t *b = &banks[live];
+    fed |= 1 << CAPTURE_MATH;
+    store(&b->traces[CAPTURE_MATH], b->count - 1, m);
+}
+
+uint32_t capture_count(void) {
+    return banks[shown].count;
+}
+
+/**
+ * Oldest position still in the capture
+ */
+uint32_t capture_oldest(void) {
+    uint32_t count = banks[shown].count;
+    return count > CAPTURE_DEPTH ? count - CAPTURE_DEPTH : 0;
+}
+
+/**
+ * Min and max of positions [a, b), b > a, from the largest aligned
+ * blocks that fit
+ */
+static void range_minmax(const trace_t *trace, uint32_t a, uint32_t b,
+                         uint16_t *min, uint16_t *max) {
+    uint16_t lo = 0xFFFF, hi = 0;
+    
+    while (a < b) {
+        int k = 0;
+        while (k < CAPTURE_DEPTH_LOG2 && !(a & (1u << k)) && (2u << k) <= b - a) {
+            k++;
+        }
+        if (k == 0) {
+            uint16_t s = trace->raw[a & RAW_MASK];
+            if (s < lo) lo = s;
+            if (s > hi) hi = s;
+        } else {
+            const minmax_t *m = &trace->pyramid[LEVEL_BASE(k) + ((a >> k) & LEVEL_MASK(k))];
+            if (m->min < lo) lo = m->min;
+            if (m->max > hi) hi = m->max;
+        }
+        a += 1u << k;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+/**
+ * Rounded mean of positions [a, b), b > a, b - a <= 65536
+ */
+static uint16_t range_mean(const trace_t *trace, uint32_t count, uint32_t a, uint32_t b) {
+    uint32_t end = b == count ? trace->total : trace->sums[b & RAW_MASK];
+    uint32_t sum = end - trace->sums[a & RAW_MASK];
+    uint32_t n = b - a;
+    return (uint16_t)((sum + n / 2) / n);
+}
+
+/**
+ * Column c covers [start + c*span/columns, start + (c+1)*span/columns)
+ * with start = end - span, at least one sample. A window reaching past
+ * the newest sample is moved back; columns older than the capture get
+ * min > max.
+ */
+static void view(int channel, uint32_t end, uint32_t span, int columns,
+                 uint16_t *mins, uint16_t *maxs, bool mean) {
+    const bank_t *bank = &banks[shown];
+    const trace_t *trace = &bank->traces[channel];
+    uint32_t count = bank->count;
+    uint32_t oldest = capture_oldest();
+    if (columns <= 0) return;
+    if (end > count) end = count;
+    
+    int64_t start = (int64_t)end - span;
+    for (int c = 0; c < columns; c++) {
+        int64_t a = start + (int64_t)((uint64_t)span * c / columns);
+        int64_t b = start + (int64_t)((uint64_t)span * (c + 1) / columns);
+        if (b <= a) b = a + 1;
+        if (a < oldest) a = oldest;
+        if (b > end) b = end;
+        if (a >= b) {
+            mins[c] = 0xFFFF;
+            maxs[c] = 0;
+        } else if (mean) {
+            mins[c] = maxs[c] = range_mean(trace, count, (uint32_t)a, (uint32_t)b);
+        } else {
+            range_minmax(trace, (uint32_t)a, (uint32_t)b, &mins[c], &maxs[c]);
+        }
+    }
+}
+
+/**
+ * Reduce the span samples of channel (0 = CH1) ending before position
+ * end to columns min/max pairs, laid out as described for view()
+ */
+void capture_view(int channel, uint32_t end, uint32_t span, int columns,
+                  uint16_t *mins, uint16_t *maxs) {
+    view(channel, end, span, columns, mins, maxs, false);
+}
+
+/**
+ * As capture_view(), with min and max both set to the column's mean.
+ * Columns must not exceed 65536 samples.
+ */
+void capture_view_mean(int channel, uint32_t end, uint32_t span, int columns,
+                       uint16_t *mins, uint16_t *maxs) {
+    view(channel, end, span, columns, mins, maxs, true);
+}
+
+/**
+ * Copy the n raw samples of channel ending before position end, oldest
+ * first. Returns n, or 0 when the capture on display does not hold them
+ * all.
+ */
+int capture_read(int channel, uint32_t end, int n, uint16_t *out) {
+    const bank_t *bank = &banks[shown];
+    const uint16_t *raw = bank->traces[channel].raw;
+    if (end > bank->count) end = bank->count;
+    if (n <= 0 || end < (uint32_t)n || end - n < capture_oldest()) return 0;
+    
+    for (uint32_t p = end - n; p < end; p++) {
+        *out++ = raw[p & RAW_MASK];
+    }
+    return n;
+}
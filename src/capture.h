@@ -0,0 +1,63 @@
+/**
+ * capture.h - Deep capture memory with a min/max decimation pyramid
+ *
+ * capture_feed() appends every sample to a ring of the last
+ * CAPTURE_DEPTH samples and keeps, for each level k, the min and max of
+ * every aligned block of 2^k samples. The pyramid is updated as samples
+ * arrive, so it is always complete up to the newest sample.
+ *
+ * capture_view() reduces any window of the capture to one min/max pair
+ * per screen column. Each column is covered by aligned pyramid blocks,
+ * at most two per level, so the cost depends on the number of columns
+ * and not on how many samples are in view, and the result is exact: a
+ * one-sample glitch shows up in its column at every zoom level.
+ *
+ * capture_view_mean() gives each column the mean of its samples instead,
+ * from a ring of running sums: one subtraction per column at any zoom.
+ *
+ * capture_read() copies raw samples out, for processing that needs every
+ * one of them.
+ *
+ * Positions are absolute sample numbers, counted from capture_reset().
+ *
+ * There are two banks. capture_freeze() puts a copy of the live bank on
+ * display and leaves it untouched while samples keep going to the live
+ * bank; capture_thaw() shows the live bank again, so nothing acquired
+ * while frozen is lost. capture_count(), _oldest() and _view() refer to
+ * the bank on display.
+ *
+ * In dual-channel mode capture_feed_pair() stores a CH2 sample alongside
+ * every CH1 sample, with its own pyramid, so both traces share positions
+ * and one view window. capture_feed_math() adds the math trace's sample
+ * for the position just fed in the same way.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per bank and channel: 256k samples (512 KB, ~8.7 minutes at 500 S/s),
+// the pyramid (1 MB) and the running sums (1 MB); 15 MB of the board's
+// 32 MB in all
+#define CAPTURE_DEPTH_LOG2  18
+#define CAPTURE_DEPTH       (1u << CAPTURE_DEPTH_LOG2)
+#define CAPTURE_CHANNELS    3
+#define CAPTURE_MATH        2       // Channel of the math trace
+
+void capture_reset(void);
+void capture_feed(uint16_t sample);
+void capture_feed_pair(uint16_t ch1, uint16_t ch2);
+void capture_feed_math(uint16_t math);
+void capture_freeze(void);
+void capture_thaw(void);
+uint32_t capture_count(void);
+uint32_t capture_oldest(void);
+void capture_view(int channel, uint32_t end, uint32_t span, int columns,
+                  uint16_t *mins, uint16_t *maxs);
+void capture_view_mean(int channel, uint32_t end, uint32_t span, int columns,
+                       uint16_t *mins, uint16_t *maxs);
+int capture_read(int channel, uint32_t end, int n, uint16_t *out);
+
+#endif // CAPTURE_H
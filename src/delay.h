@@ -1,12 +1,44 @@
-
 #ifndef DELAY_H
 #define DELAY_H
 
 #include <stdint.h>
+#include "hal.h"
+#include "timer.h"
+
+// Cycle constants derived from the system clock at compile time
+#define CYCLES_PER_US       (SYSTEM_CLOCK_FREQ / 1000000)
+#define CYCLES_PER_MS       (SYSTEM_CLOCK_FREQ / 1000)
+
+// Nanoseconds to cycles, rounded up so a delay is never too short
+#define NS_TO_CYCLES(ns)    ((uint32_t)(((ns) * CYCLES_PER_US + 999) / 1000))
+
+/**
+ * Current value of the free-running cycle counter. It wraps every
+ * 2^32 cycles (~143 s at 30 MHz); compare times by subtraction.
+ */
+static inline uint32_t cycles_now(void) {
+    return hal_read_cycles();
+}
+
+/**
+ * Spin until the cycle counter reaches deadline. Returns at once if the
+ * deadline has already passed (deadlines up to 2^31 cycles ahead).
+ */
+static inline void delay_until(uint32_t deadline) {
+    while ((int32_t)(deadline - cycles_now()) > 0) {
+    }
+}
 
 void delay_cycles(uint32_t cycles);
 void delay_us(uint32_t microseconds);
 void delay_ms(uint32_t milliseconds);
-void delay_ns(uint64_t nanoseconds);
 
-#endif // DELAY_H
\ No newline at end of file
+/**
+ * With a constant argument the conversion folds to a cycle count at
+ * compile time.
+ */
+static inline void delay_ns(uint32_t nanoseconds) {
+    delay_cycles(NS_TO_CYCLES(nanoseconds));
+}
+
+#endif // DELAY_H
@@ -1,12 +1,13 @@
 #include "dtekv-lib.h"
+#include "hal.h"
 
-#define JTAG_UART ((volatile unsigned int*) 0x04000040)
-#define JTAG_CTRL ((volatile unsigned int*) 0x04000044)
+#define JTAG_UART 0x04000040
+#define JTAG_CTRL 0x04000044
 
 void printc(char s)
 {
-    while (((*JTAG_CTRL)&0xffff0000) == 0);
-    *JTAG_UART = s;
+    while ((hal_read32(JTAG_CTRL)&0xffff0000) == 0);
+    hal_write32(JTAG_UART, s);
 }
 
 void print(char *s)
@@ -0,0 +1,220 @@
+/**
+ * fft.c - Fixed-point spectrum of a block of samples
+ *
+ * Q15 throughout: products are 32-bit and rounded back with >> 15.
+ * Magnitudes can double per stage, so a stage halves its outputs when
+ * any of its inputs might overflow and the transforms return the number
+ * of halvings as a block exponent. A full-scale tone is halved at almost
+ * every stage; noise and small signals keep more bits, so the rounding
+ * floor sits some 75 dB below the largest bin rather than below full
+ * scale. Halving rounds ties to even: rounding them up would add a bias
+ * that piles up in the bins around DC.
+ *
+ * The tables are for FFT_MAX_POINTS. A smaller transform steps through
+ * them with a stride, so one set serves every size.
+ */
+
+#include "fft.h"
+#include "dsp_tables.h"
+
+#define ROUND_Q15(x)        (((x) + (1 << 14)) >> 15)
+// x / 2^s for s of 0 or 1, ties to even so repeated halving has no bias
+#define HALVE(x, s)         (((x) + (((x) >> 1) & (s))) >> (s))
+
+// Window names for the display, 4 characters at most
+static const char *const window_names[FFT_WINDOWS] = {
+    [FFT_WINDOW_HANN]     = "Hann",
+    [FFT_WINDOW_BLACKMAN] = "Blk",
+    [FFT_WINDOW_FLATTOP]  = "Flat",
+    [FFT_WINDOW_RECT]     = "Rect",
+};
+
+// fft_spectrum() working storage
+static int16_t windowed[FFT_MAX_POINTS];
+static int16_t bins_re[FFT_MAX_POINTS / 2];
+static int16_t bins_im[FFT_MAX_POINTS / 2];
+
+static inline int16_t sat16(int32_t x) {
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+/**
+ * Bits set in any magnitude of the block, so (bits >> 13) != 0 when
+ * some value is at or beyond 2^13
+ */
+static inline uint32_t magnitude_bits(int32_t x) {
+    return (uint32_t)(x ^ (x >> 31));
+}
+
+/**
+ * In-place complex FFT of 2^log2n points, log2n <= FFT_MAX_LOG2 - 1,
+ * decimation in time, output in natural order. Block floating point: a
+ * stage halves its outputs only when some input is at or beyond 2^13
+ * and could overflow; returns how many did, so the result is the DFT
+ * scaled by 2^-exponent. Small inputs keep their resolution.
+ */
+int fft_complex_q15(int16_t *re, int16_t *im, int log2n) {
+    int n = 1 << log2n;
+    int exponent = 0;
+    uint32_t bits = 0;
+
+    // Bit-reversed reordering
+    for (int i = 0, j = 0; i < n; i++) {
+        bits |= magnitude_bits(re[i]) | magnitude_bits(im[i]);
+        if (i < j) {
+            int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+    }
+
+    // Butterflies of span 2*half use W = e^(-2 pi i j / (2*half))
+    for (int half = 1, stride = FFT_MAX_POINTS / 2; half < n; half <<= 1, stride >>= 1) {
+        int shift = (bits >> 13) != 0;
+        exponent += shift;
+        bits = 0;
+        for (int j = 0; j < half; j++) {
+            int32_t wr = fft_cos_q15[j * stride];
+            int32_t wi = -fft_sin_q15[j * stride];
+            for (int a = j; a < n; a += half << 1) {
+                int b = a + half;
+                int32_t tr = ROUND_Q15(wr * re[b] - wi * im[b]);
+                int32_t ti = ROUND_Q15(wr * im[b] + wi * re[b]);
+                int32_t ar = re[a], ai = im[a];
+                re[a] = sat16(HALVE(ar + tr, shift));
+                im[a] = sat16(HALVE(ai + ti, shift));
+                re[b] = sat16(HALVE(ar - tr, shift));
+                im[b] = sat16(HALVE(ai - ti, shift));
+                bits |= magnitude_bits(re[a]) | magnitude_bits(im[a]) |
+                        magnitude_bits(re[b]) | magnitude_bits(im[b]);
+            }
+        }
+    }
+    return exponent;
+}
+
+/**
+ * Bins 0..N/2-1 of the DFT of N = 2^log2n real samples,
+ * FFT_MIN_LOG2 <= log2n <= FFT_MAX_LOG2. re and im hold N/2 values,
+ * scaled by 2^-exponent for the exponent returned, at most log2n.
+ *
+ * The even samples go in as the real parts and the odd ones as the
+ * imaginary parts of an N/2-point complex FFT Z. Bins k and N/2-k then
+ * come out of Z[k] and Z[N/2-k] together:
+ *   E = (Z[k] + conj Z[N/2-k]) / 2,  O = -i (Z[k] - conj Z[N/2-k]) / 2
+ *   X[k] = E + W^k O,  X[N/2-k] = conj(E - W^k O),  W = e^(-2 pi i / N)
+ */
+int fft_real_q15(const int16_t *x, int log2n, int16_t *re, int16_t *im) {
+    int m = 1 << (log2n - 1);
+    int stride = FFT_MAX_POINTS >> log2n;
+
+    for (int i = 0; i < m; i++) {
+        re[i] = x[2 * i];
+        im[i] = x[2 * i + 1];
+    }
+    int exponent = fft_complex_q15(re, im, log2n - 1);
+
+    uint32_t bits = 0;
+    for (int i = 0; i < m; i++) {
+        bits |= magnitude_bits(re[i]) | magnitude_bits(im[i]);
+    }
+    int shift = (bits >> 13) != 0;
+
+    // Bin 0: E = Re Z[0], O = Im Z[0]; Nyquist is dropped
+    re[0] = sat16(HALVE((int32_t)re[0] + im[0], shift));
+    im[0] = 0;
+
+    for (int k = 1; k < m - k; k++) {
+        int32_t zr = re[k], zi = im[k];
+        int32_t mr = re[m - k], mi = im[m - k];
+        int32_t er = HALVE(zr + mr, 1);
+        int32_t ei = HALVE(zi - mi, 1);
+        int32_t or_ = HALVE(zi + mi, 1);
+        int32_t oi = HALVE(mr - zr, 1);
+        int32_t wr = fft_cos_q15[k * stride];
+        int32_t wi = -fft_sin_q15[k * stride];
+        int32_t tr = ROUND_Q15(wr * or_ - wi * oi);
+        int32_t ti = ROUND_Q15(wr * oi + wi * or_);
+        re[k] = sat16(HALVE(er + tr, shift));
+        im[k] = sat16(HALVE(ei + ti, shift));
+        re[m - k] = sat16(HALVE(er - tr, shift));
+        im[m - k] = sat16(HALVE(ti - ei, shift));
+    }
+
+    // Bin N/4 pairs with itself: X = conj Z
+    int q = m >> 1;
+    re[q] = (int16_t)HALVE((int32_t)re[q], shift);
+    im[q] = sat16(HALVE(-(int32_t)im[q], shift));
+    return exponent + shift;
+}
+
+/**
+ * 10 log10(power) in centi-dB, FFT_CDB_ZERO for 0: 3.0103 dB per bit
+ * of the leading one's position plus a table entry for the 8 bits below
+ * it
+ */
+int32_t fft_power_cdb(uint32_t power) {
+    if (power == 0) return FFT_CDB_ZERO;
+
+    int msb = 0;
+    for (int step = 16; step > 0; step >>= 1) {
+        if (power >> (msb + step)) msb += step;
+    }
+    uint32_t frac = msb >= 8 ? power >> (msb - 8) : power << (8 - msb);
+    return (msb * 30103 + 50) / 100 + fft_log_frac_cdb[frac & 0xFF];
+}
+
+/**
+ * Level of bins 0..N/2-1 of N = 2^log2n ADC samples, centi-dB relative
+ * to a full-scale sine. The mean is removed first, so bin 0 shows only
+ * what the window leaves of it.
+ */
+void fft_spectrum(const uint16_t *samples, int log2n, int window, int16_t *cdbfs) {
+    int n = 1 << log2n;
+    int stride = FFT_MAX_POINTS >> log2n;
+    const int16_t *w = fft_window_q15[window];
+
+    uint32_t sum = 0;
+    int32_t lo = 0xFFFF, hi = 0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+        if (samples[i] < lo) lo = samples[i];
+        if (samples[i] > hi) hi = samples[i];
+    }
+    int32_t mean = (int32_t)((sum + (n >> 1)) >> log2n);
+
+    // Scale quiet blocks up to 2^13..2^14 before the window, so neither
+    // its rounding nor the transform's comes near the signal. A unipolar
+    // block, such as a narrow pulse from 0 to full scale, can swing up to
+    // 65535 from its mean: that is halved (up = -1) rather than clipped.
+    uint32_t bits = magnitude_bits(hi - mean) | magnitude_bits(lo - mean);
+    int up = 0;
+    if (bits > 0x7FFF) up = -1;
+    else while (bits != 0 && (bits << up) < 0x2000) up++;
+
+    for (int i = 0; i < n; i++) {
+        int32_t d = (int32_t)samples[i] - mean;
+        int32_t x = sat16(up < 0 ? HALVE(d, 1) : d * (1 << up));
+        int32_t c = w[(i <= n / 2 ? i : n - i) * stride];
+        windowed[i] = (int16_t)ROUND_Q15(x * c);
+    }
+
+    int exponent = fft_real_q15(windowed, log2n, bins_re, bins_im);
+
+    // Bins are X / 2^(exponent - up) and the reference is for X / N,
+    // 6.0206 dB per bit of difference
+    int32_t ref = fft_window_ref_cdb[window] + (log2n - exponent + up) * 60206 / 100;
+    for (int k = 0; k < n / 2; k++) {
+        int32_t r = bins_re[k], i = bins_im[k];
+        int32_t cdb = fft_power_cdb((uint32_t)(r * r) + (uint32_t)(i * i)) - ref;
+        cdbfs[k] = (int16_t)(cdb < FFT_CDB_ZERO ? FFT_CDB_ZERO : cdb);
+    }
+}
+
+const char *fft_window_name(int window) {
+    return window_names[window];
+}
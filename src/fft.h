@@ -0,0 +1,44 @@
+/**
+ * fft.h - Fixed-point spectrum of a block of samples
+ *
+ * fft_real_q15() transforms N = 2^log2n real Q15 samples with an
+ * N/2-point complex radix-2 FFT and one split pass, in block floating
+ * point: a stage halves its outputs only when they could overflow, and
+ * the result comes with the exponent of those halvings. The twiddle
+ * factors, the window shapes and the dB fractions come from
+ * dsp_tables.h, which host/gen_tables.c writes at build time; the core
+ * never evaluates a sine or a logarithm.
+ *
+ * fft_spectrum() is the display path: remove the block's mean, apply a
+ * window, transform, and give each bin's power in centi-dB relative to a
+ * full-scale sine (0 dBFS), so a tone reads the same level whatever the
+ * window.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+
+// 256, 512 or 1024 points
+#define FFT_MIN_LOG2        8
+#define FFT_MAX_LOG2        10
+#define FFT_MAX_POINTS      (1 << FFT_MAX_LOG2)
+
+// Window shapes
+#define FFT_WINDOW_HANN     0
+#define FFT_WINDOW_BLACKMAN 1
+#define FFT_WINDOW_FLATTOP  2   // Amplitude accurate to 0.01 dB between bins
+#define FFT_WINDOW_RECT     3   // No window
+#define FFT_WINDOWS         4
+
+// Level given to a bin with no power at all, centi-dB
+#define FFT_CDB_ZERO        (-12000)
+
+int fft_complex_q15(int16_t *re, int16_t *im, int log2n);
+int fft_real_q15(const int16_t *x, int log2n, int16_t *re, int16_t *im);
+int32_t fft_power_cdb(uint32_t power);
+void fft_spectrum(const uint16_t *samples, int log2n, int window, int16_t *cdbfs);
+const char *fft_window_name(int window);
+
+#endif // FFT_H
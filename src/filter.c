@@ -0,0 +1,143 @@
+/**
+ * filter.c - Fixed-point filter stage between acquisition and display
+ *
+ * Samples are taken as signed values around mid-scale. Biquads run in
+ * direct form I with FILTER_STATE_SHIFT fraction bits in their states,
+ * so the long tail of the 1 Hz high-pass is not rounded away one code
+ * at a time; each product is 32x32 bits into a 64-bit sum, a mul/mulh
+ * pair on the core. Outputs are clamped to the ADC range, which also
+ * stops a section from winding up on a step at full scale.
+ *
+ * The FIR delay line holds every sample twice, FILTER_FIR_TAPS apart, so
+ * the newest FILTER_FIR_TAPS samples are always one contiguous run and
+ * the tap loop has no wrap test. The taps are symmetric: each multiply
+ * takes the pair of samples sharing a tap.
+ */
+
+#include "filter.h"
+#include "dsp_tables.h"
+
+#define MID_SCALE           32768
+#define STATE_MAX           ((int32_t)MID_SCALE << FILTER_STATE_SHIFT)
+#define FIR_MID             (FILTER_FIR_TAPS / 2)
+
+// Names for the display, 3 characters at most
+static const char *const names[FILTER_COUNT] = {
+    [FILTER_NONE]     = "",
+    [FILTER_LOWPASS]  = "LP",
+    [FILTER_HIGHPASS] = "HP",
+    [FILTER_NOTCH50]  = "N50",
+    [FILTER_NOTCH60]  = "N60",
+    [FILTER_FIR]      = "FIR",
+    [FILTER_FIR_DEC2] = "F/2",
+    [FILTER_FIR_DEC4] = "F/4",
+};
+
+void filter_init(filter_t *f, int type) {
+    f->type = type;
+    f->sections = 0;
+    f->coefs = 0;
+    f->taps = 0;
+    f->decimation = 1;
+
+    switch (type) {
+    case FILTER_LOWPASS:  f->coefs = filter_lowpass_q28;  f->sections = 2; break;
+    case FILTER_HIGHPASS: f->coefs = filter_highpass_q28; f->sections = 1; break;
+    case FILTER_NOTCH50:  f->coefs = filter_notch50_q28;  f->sections = 2; break;
+    case FILTER_NOTCH60:  f->coefs = filter_notch60_q28;  f->sections = 2; break;
+    case FILTER_FIR:      f->taps = filter_fir_low_q15; break;
+    case FILTER_FIR_DEC2: f->taps = filter_fir_high_q15; f->decimation = 2; break;
+    case FILTER_FIR_DEC4: f->taps = filter_fir_low_q15;  f->decimation = 4; break;
+    default:              f->type = FILTER_NONE; break;
+    }
+
+    for (int i = 0; i < FILTER_MAX_SECTIONS; i++) {
+        for (int k = 0; k < 5; k++) f->state[i][k] = 0;
+    }
+    for (int i = 0; i < 2 * FILTER_FIR_TAPS; i++) f->delay[i] = 0;
+    f->pos = 0;
+    f->phase = 0;
+}
+
+static inline int32_t clamp_state(int32_t v) {
+    if (v > STATE_MAX - 1) return STATE_MAX - 1;
+    if (v < -STATE_MAX) return -STATE_MAX;
+    return v;
+}
+
+/**
+ * One section, x and the result with FILTER_STATE_SHIFT fraction bits.
+ * The bits dropped from y go into the next sum (error feedback): the
+ * rounding error is then shaped away from DC, where the poles of the
+ * low- and high-pass filters would otherwise amplify it into an offset
+ * or a dead band.
+ */
+static inline int32_t biquad(const biquad_coefs_t *c, int32_t *s, int32_t x) {
+    int64_t acc = (int64_t)c->b0 * x + (int64_t)c->b1 * s[0] + (int64_t)c->b2 * s[1]
+                - (int64_t)c->a1 * s[2] - (int64_t)c->a2 * s[3] + s[4];
+    int32_t y = clamp_state((int32_t)(acc >> FILTER_COEF_SHIFT));
+    s[4] = (int32_t)(acc & ((1 << FILTER_COEF_SHIFT) - 1));
+    s[1] = s[0];
+    s[0] = x;
+    s[3] = s[2];
+    s[2] = y;
+    return y;
+}
+
+/**
+ * Push x into the delay line; every decimation-th sample returns true
+ * with the filtered value in *y
+ */
+static inline bool fir(filter_t *f, int32_t x, int32_t *y) {
+    int p = f->pos;
+    f->delay[p] = f->delay[p + FILTER_FIR_TAPS] = (int16_t)x;
+    f->pos = p + 1 == FILTER_FIR_TAPS ? 0 : p + 1;
+    if (++f->phase < f->decimation) return false;
+    f->phase = 0;
+
+    // Oldest sample first, newest at d[FILTER_FIR_TAPS - 1]
+    const int16_t *d = &f->delay[p + 1];
+    const int16_t *h = f->taps;
+    int32_t acc = h[FIR_MID] * d[FIR_MID];
+    for (int k = 0; k < FIR_MID; k++) {
+        acc += h[k] * (d[k] + d[FILTER_FIR_TAPS - 1 - k]);
+    }
+    *y = (acc + (1 << 14)) >> 15;
+    return true;
+}
+
+static inline uint16_t to_code(int32_t v) {
+    v += MID_SCALE;
+    if (v < 0) return 0;
+    if (v > 65535) return 65535;
+    return (uint16_t)v;
+}
+
+/**
+ * Filter n samples from in to out, which may be the same array. Returns
+ * the number of samples written: n, or fewer when decimating.
+ */
+int filter_process(filter_t *f, const uint16_t *in, uint16_t *out, int n) {
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t x = (int32_t)in[i] - MID_SCALE;
+
+        if (f->taps) {
+            int32_t y;
+            if (fir(f, x, &y)) out[m++] = to_code(y);
+        } else if (f->sections > 0) {
+            int32_t v = x * (1 << FILTER_STATE_SHIFT);
+            for (int s = 0; s < f->sections; s++) {
+                v = biquad(&f->coefs[s], f->state[s], v);
+            }
+            out[m++] = to_code((v + (1 << (FILTER_STATE_SHIFT - 1))) >> FILTER_STATE_SHIFT);
+        } else {
+            out[m++] = in[i];
+        }
+    }
+    return m;
+}
+
+const char *filter_name(int type) {
+    return names[type];
+}
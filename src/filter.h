@@ -0,0 +1,67 @@
+/**
+ * filter.h - Fixed-point filter stage between acquisition and display
+ *
+ * Samples pass through filter_process() before the trigger, the capture
+ * and the measurements, so all of them see the filtered signal. The
+ * IIR filters are cascades of biquads; the FIR filters are symmetric
+ * low-pass filters that can decimate. Every filter's coefficients are
+ * designed for FILTER_RATE_HZ and written into dsp_tables.h at build
+ * time by host/gen_tables.c.
+ *
+ * Per sample a biquad costs five 32x32-bit multiplies into a 64-bit sum;
+ * an FIR output costs FILTER_FIR_TAPS/2 + 1 multiplies, and with
+ * decimation by D only every D-th sample produces one.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Filter types
+#define FILTER_NONE         0
+#define FILTER_LOWPASS      1   // 4th-order Butterworth at FILTER_LOWPASS_HZ
+#define FILTER_HIGHPASS     2   // 2nd-order Butterworth at FILTER_HIGHPASS_HZ, removes DC
+#define FILTER_NOTCH50      3   // Notches at 50 Hz and 150 Hz
+#define FILTER_NOTCH60      4   // Notches at 60 Hz and 180 Hz
+#define FILTER_FIR          5   // FIR low-pass at FILTER_FIR_LOW_HZ
+#define FILTER_FIR_DEC2     6   // FIR low-pass at FILTER_FIR_HIGH_HZ, keeps every 2nd sample
+#define FILTER_FIR_DEC4     7   // FIR low-pass at FILTER_FIR_LOW_HZ, keeps every 4th sample
+#define FILTER_COUNT        8
+
+// Design parameters
+#define FILTER_RATE_HZ      500     // Sample rate the coefficients are designed for
+#define FILTER_LOWPASS_HZ   40
+#define FILTER_HIGHPASS_HZ  1
+#define FILTER_NOTCH_Q      8       // Centre frequency over -3 dB bandwidth
+#define FILTER_FIR_TAPS     63      // Odd, so the centre tap is a sample
+#define FILTER_FIR_LOW_HZ   40      // -6 dB; the stop band starts below 62.5 Hz, Nyquist after /4
+#define FILTER_FIR_HIGH_HZ  100     // Stop band from 125 Hz, Nyquist after /2
+
+#define FILTER_MAX_SECTIONS 2
+#define FILTER_COEF_SHIFT   28      // Biquad coefficients are Q28
+#define FILTER_STATE_SHIFT  8       // Biquad states keep 8 bits below an ADC code
+
+// One biquad: y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+} biquad_coefs_t;
+
+typedef struct {
+    int type;
+    int sections;
+    const biquad_coefs_t *coefs;
+    int32_t state[FILTER_MAX_SECTIONS][5];  // x1, x2, y1, y2, bits dropped from y
+    const int16_t *taps;                    // First half and centre, Q15
+    int decimation;
+    int phase;                              // Samples since the last FIR output
+    int pos;                                // Next delay line slot
+    int16_t delay[2 * FILTER_FIR_TAPS];     // Each sample twice, FILTER_FIR_TAPS apart
+} filter_t;
+
+void filter_init(filter_t *f, int type);
+int filter_process(filter_t *f, const uint16_t *in, uint16_t *out, int n);
+const char *filter_name(int type);
+
+#endif // FILTER_H
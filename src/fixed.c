@@ -0,0 +1,75 @@
+/**
+ * fixed.c - Scaled-integer number formatting
+ */
+
+#include "fixed.h"
+
+static const int32_t pow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/**
+ * Format value / 10^scale with the given number of decimals, truncated
+ * toward zero like the float display code it replaces. For example
+ * fixed_format(buf, 1999500, 6, 2) writes "1.99". Returns the length.
+ */
+int fixed_format(char *buf, int32_t value, int scale, int decimals) {
+    char digits[12];
+    int len = 0, n = 0;
+    uint32_t v;
+    
+    if (scale < 0) scale = 0;
+    if (scale > 9) scale = 9;
+    if (decimals > scale) decimals = scale;
+    
+    if (value < 0) {
+        buf[len++] = '-';
+        v = -(uint32_t)value;
+    } else {
+        v = value;
+    }
+    
+    uint32_t ipart = v / pow10[scale];
+    uint32_t fpart = (v % pow10[scale]) / pow10[scale - decimals];
+    
+    // Integer part
+    do {
+        digits[n++] = '0' + ipart % 10;
+        ipart /= 10;
+    } while (ipart > 0);
+    while (n > 0) buf[len++] = digits[--n];
+    
+    // Decimals, zero padded
+    if (decimals > 0) {
+        buf[len++] = '.';
+        for (int d = decimals - 1; d >= 0; d--) {
+            buf[len + d] = '0' + fpart % 10;
+            fpart /= 10;
+        }
+        len += decimals;
+    }
+    
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Integer square root, floor(sqrt(x)), one result bit per step with
+ * shifts and adds only
+ */
+uint32_t fixed_isqrt64(uint64_t x) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    
+    while (bit > x) bit >>= 2;
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
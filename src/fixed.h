@@ -0,0 +1,20 @@
+/**
+ * fixed.h - Scaled-integer helpers for the measurement and display path
+ *
+ * The core has no FPU, so voltages and times are carried as integers in
+ * small units (microvolts, millivolts, microseconds) and only turned into
+ * decimal text at the edge.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+// Longest string fixed_format() writes, including the terminator
+#define FIXED_FORMAT_MAX    16
+
+int fixed_format(char *buf, int32_t value, int scale, int decimals);
+uint32_t fixed_isqrt64(uint64_t x);
+
+#endif // FIXED_H
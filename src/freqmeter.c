@@ -0,0 +1,138 @@
+/**
+ * freqmeter.c - Streaming frequency, period and duty-cycle estimator
+ *
+ * Sample times are 32-bit Q16 counts that wrap every 65536 samples, so
+ * every interval is a difference, valid up to 65535 samples (over two
+ * minutes at 500 S/s; FREQ_STALE_SAMPLES is far below that).
+ */
+
+#include "freqmeter.h"
+
+static int32_t env_max, env_min;    // Envelope, raw codes << 8
+static uint16_t prev;               // Previous sample
+static uint32_t n;                  // Samples fed
+static uint8_t high;                // Schmitt trigger state
+static uint8_t primed;              // prev and the envelope are valid
+
+// Midpoint crossings seen since the last confirmed edge, Q16 sample time
+static uint32_t cand_rise, cand_fall;
+
+// Gate
+static uint8_t have_rise;
+static uint32_t last_rise;          // Last confirmed rising edge
+static uint32_t gate_start;         // Rising edge that opened the gate
+static uint32_t gate_periods;
+static uint32_t gate_high;          // Summed high time of the gate's periods
+static uint32_t pending_high;       // High time of the period in progress
+static uint8_t have_pending_high;
+
+static freq_result_t last_result;
+static uint8_t last_valid;
+
+void freq_reset(void) {
+    primed = 0;
+    n = 0;
+    high = 0;
+    have_rise = 0;
+    have_pending_high = 0;
+    gate_periods = 0;
+    gate_high = 0;
+    last_valid = 0;
+}
+
+static void on_rise(uint32_t t) {
+    if (have_rise) {
+        if (gate_periods == 0) gate_start = last_rise;
+        gate_periods++;
+        if (have_pending_high) gate_high += pending_high;
+    }
+    have_rise = 1;
+    have_pending_high = 0;
+    last_rise = t;
+}
+
+static void on_fall(uint32_t t) {
+    if (have_rise) {
+        pending_high = t - last_rise;
+        have_pending_high = 1;
+    }
+}
+
+/**
+ * Q16 time at which the line from sample i-1 (p) to sample i (s) crosses
+ * mid, for a crossing in either direction
+ */
+static inline uint32_t crossing(uint32_t i, int32_t p, int32_t s, int32_t mid) {
+    uint32_t num = (uint32_t)(s > p ? mid - p : p - mid);
+    uint32_t den = (uint32_t)(s > p ? s - p : p - s);
+    return ((i - 1) << 16) + (num << 16) / den;
+}
+
+void freq_feed(uint16_t s) {
+    int32_t v = (int32_t)s << 8;
+    uint32_t i = n++;
+    
+    if (!primed) {
+        env_max = env_min = v;
+        prev = s;
+        primed = 1;
+        return;
+    }
+    
+    // Envelope: jump to new extremes, otherwise relax toward the signal
+    if (v > env_max) env_max = v;
+    else env_max -= (env_max - v) >> FREQ_DECAY_SHIFT;
+    if (v < env_min) env_min = v;
+    else env_min += (v - env_min) >> FREQ_DECAY_SHIFT;
+    
+    int32_t swing = (env_max - env_min) >> 8;
+    int32_t mid = (env_max + env_min) >> 9;
+    int32_t band = swing >> 3;
+    
+    if (prev < mid && s >= mid) cand_rise = crossing(i, prev, s, mid);
+    if (prev > mid && s <= mid) cand_fall = crossing(i, prev, s, mid);
+    prev = s;
+    
+    if (swing < FREQ_MIN_SWING) return;
+    
+    if (!high && s >= mid + band) {
+        high = 1;
+        on_rise(cand_rise);
+    } else if (high && s <= mid - band) {
+        high = 0;
+        on_fall(cand_fall);
+    }
+}
+
+/**
+ * Close the gate and report its average. While the current gate has no
+ * whole period yet the previous result is repeated, until no edge has
+ * been seen for FREQ_STALE_SAMPLES. Returns false when there is nothing
+ * to report.
+ */
+bool freq_read(freq_result_t *result) {
+    if (gate_periods > 0) {
+        uint32_t span = last_rise - gate_start;
+        last_result.periods = gate_periods;
+        last_result.period_q16 = span / gate_periods;
+        last_result.duty_permille = (uint16_t)((uint64_t)gate_high * 1000 / span);
+        last_valid = 1;
+        
+        gate_periods = 0;
+        gate_high = 0;
+    } else if (!have_rise || ((n << 16) - last_rise) >> 16 > FREQ_STALE_SAMPLES) {
+        last_valid = 0;
+    }
+    
+    if (!last_valid) return false;
+    *result = last_result;
+    return true;
+}
+
+/**
+ * Frequency in mHz for a sample rate given in mHz
+ */
+uint32_t freq_to_millihertz(const freq_result_t *result, uint32_t sample_rate_mhz) {
+    if (result->period_q16 == 0) return 0;
+    return (uint32_t)(((uint64_t)sample_rate_mhz << 16) / result->period_q16);
+}
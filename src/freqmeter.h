@@ -0,0 +1,40 @@
+/**
+ * freqmeter.h - Streaming frequency, period and duty-cycle estimator
+ *
+ * freq_feed() takes one sample at a time in O(1) with no sample buffer.
+ * A decaying min/max envelope gives the midpoint; a Schmitt trigger with
+ * a band of 1/8 of the swing around it confirms edges, and each edge is
+ * timed where the signal crossed the midpoint, interpolated between the
+ * two samples around the crossing. Times are in samples, Q16.
+ *
+ * Results are averaged over a gate of whole periods, from one
+ * freq_read() to the next.
+ */
+
+#ifndef FREQMETER_H
+#define FREQMETER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Smallest swing (raw codes, ~1% of full scale) that counts as a signal
+#define FREQ_MIN_SWING      656
+
+// Envelope decay: the min/max relax by 1/2^n of the distance per sample
+#define FREQ_DECAY_SHIFT    9
+
+// Without an edge for this many samples the last result is dropped
+#define FREQ_STALE_SAMPLES  8192
+
+typedef struct {
+    uint32_t periods;           // Whole periods in the gate
+    uint32_t period_q16;        // Average period in samples, Q16
+    uint16_t duty_permille;     // High time over period, 0-1000
+} freq_result_t;
+
+void freq_reset(void);
+void freq_feed(uint16_t sample);
+bool freq_read(freq_result_t *result);
+uint32_t freq_to_millihertz(const freq_result_t *result, uint32_t sample_rate_mhz);
+
+#endif // FREQMETER_H
@@ -0,0 +1,57 @@
+/**
+ * hal.h - Thin memory-mapped I/O access layer
+ *
+ * All peripheral register accesses go through hal_read32()/hal_write32(),
+ * and VGA pixel stores through hal_write16().
+ * On the DTEK-V board these are plain volatile loads and stores to the
+ * device address. When built with HOST_SIM defined the same calls are
+ * routed to the simulated peripherals in host/, so the drivers compile
+ * and run unchanged as a Linux program.
+ *
+ * hal_read_cycles() reads the free-running CPU cycle counter.
+ * hal_idle() marks a polling loop that waits on interrupt-produced data;
+ * the simulation uses it to skip ahead to the next interrupt.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+#ifdef HOST_SIM
+
+uint32_t hal_read32(uint32_t addr);
+void hal_write32(uint32_t addr, uint32_t value);
+void hal_write16(uint32_t addr, uint16_t value);
+uint32_t hal_read_cycles(void);
+void hal_idle(void);
+
+#else
+
+static inline uint32_t hal_read32(uint32_t addr) {
+    return *(volatile uint32_t *) addr;
+}
+
+static inline void hal_write32(uint32_t addr, uint32_t value) {
+    *(volatile uint32_t *) addr = value;
+}
+
+static inline void hal_write16(uint32_t addr, uint16_t value) {
+    *(volatile uint16_t *) addr = value;
+}
+
+// Lower 32 bits of the mcycle counter
+static inline uint32_t hal_read_cycles(void) {
+    uint32_t cycles;
+    __asm__ volatile ("csrr %0, mcycle" : "=r" (cycles));
+    return cycles;
+}
+
+// Called while waiting for an interrupt to produce work. The core has no
+// low-power wait, so this is just one turn of the polling loop.
+static inline void hal_idle(void) {
+}
+
+#endif // HOST_SIM
+
+#endif // HAL_H
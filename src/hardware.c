@@ -1,4 +1,5 @@
 #include "hardware.h"
+#include "hal.h"
 #include "timer.h" 
 #include <stdint.h>
 #include <stdbool.h>
@@ -9,16 +10,14 @@
  * Takes an integer and writes it to the LED base address to control the 10 LEDs.
  */
 void set_leds(int led_mask){
-    volatile int * led_pointer = (volatile int *) LED_BASE_ADDR;
-    *led_pointer = led_mask;
+    hal_write32(LED_BASE_ADDR, led_mask);
 }
 
 /*
  * get_btn reads the status of teh push button
  */
 int get_btn(void){
-    volatile int *push_button_pointer = (volatile int *) PUSH_BUTTON_BASE_ADDR;
-    return (*push_button_pointer) & 0x01 ;    
+    return hal_read32(PUSH_BUTTON_BASE_ADDR) & 0x01;
 }
     
 
@@ -27,8 +26,7 @@ int get_btn(void){
  * Reads the status of the 10 toggle switches on the board, no parameter
  */
 int get_sw(void){
-    volatile int *switch_pointer = (volatile int *) SWITCH_BASE_ADDR;
-    return (*switch_pointer) & 0x3FF; 
+    return hal_read32(SWITCH_BASE_ADDR) & 0x3FF;
 }
 
 
@@ -67,8 +65,7 @@ void set_display( int display_number, int value){
     // Calculating the address for the specified display 
     unsigned int displayer_address = SEV_SEG_DISPLAY_BASE_ADDR + (display_number * 0x10);
 
-    volatile int *display_pointer = (volatile int *) displayer_address;
-    *display_pointer = bit_pattern; 
+    hal_write32(displayer_address, bit_pattern);
 }
 
 
@@ -23,14 +23,9 @@
 #define ADC_RST_PIN       (1 << 5)   // GPIO_[5] - Reset (active low)
 
 
-// GPIO Register Pointers
-#define pGPIO_DATA          ((volatile uint32_t *) (GPIO_BASE + 0))
-#define pGPIO_DIRECTION     ((volatile uint32_t *) (GPIO_BASE + 4))
-
-
-#define pPUSH_BUTTONS       ((volatile uint32_t *) PUSH_BUTTON_BASE_ADDR)
-#define pSWITCHES           ((volatile uint32_t *) SWITCH_BASE_ADDR)
-#define pLEDS               ((volatile uint32_t *) LED_BASE_ADDR)
+// GPIO Register Addresses (accessed through hal_read32/hal_write32)
+#define GPIO_DATA           (GPIO_BASE + 0)
+#define GPIO_DIRECTION      (GPIO_BASE + 4)
 
 
 
@@ -0,0 +1,181 @@
+/**
+ * gen_tables.c - Writes dsp_tables.h, the constant tables of the DSP code
+ *
+ * Runs on the build machine (see the Makefiles), so the firmware gets its
+ * sines, windows, logarithms and filter coefficients as initialised
+ * const arrays without a libm on the core. Sizes, table ids and filter
+ * parameters come from the firmware headers.
+ *
+ *   gen_tables > dsp_tables.h
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "fft.h"
+#include "filter.h"
+
+#define Q15_ONE     32768.0
+#define PER_LINE    8
+
+static int q15(double x) {
+    long v = lround(x * Q15_ONE);
+    if (v > 32767) v = 32767;
+    if (v < -32768) v = -32768;
+    return (int)v;
+}
+
+static void emit(const char *decl, const int *values, int n) {
+    printf("%s = {", decl);
+    for (int i = 0; i < n; i++) {
+        printf(i % PER_LINE ? " %d," : "\n    %d,", values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+// ============================================================================
+// FFT
+// ============================================================================
+
+// Cosine-sum windows, periodic: w(n) = sum a_k cos(2 pi k n / N) (-1)^k
+static const double window_terms[FFT_WINDOWS][5] = {
+    [FFT_WINDOW_HANN]     = {0.5, 0.5},
+    [FFT_WINDOW_BLACKMAN] = {0.42, 0.5, 0.08},
+    [FFT_WINDOW_FLATTOP]  = {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368},
+    [FFT_WINDOW_RECT]     = {1.0},
+};
+
+static double window_at(int w, double phase) {
+    double v = 0;
+    for (int k = 0; k < 5; k++) {
+        v += (k & 1 ? -1 : 1) * window_terms[w][k] * cos(k * phase);
+    }
+    return v;
+}
+
+static void emit_fft(void) {
+    static int table[FFT_MAX_POINTS];
+    const int half = FFT_MAX_POINTS / 2;
+
+    for (int i = 0; i < half; i++) table[i] = q15(cos(2 * M_PI * i / FFT_MAX_POINTS));
+    emit("static const int16_t fft_cos_q15[FFT_MAX_POINTS / 2]", table, half);
+    for (int i = 0; i < half; i++) table[i] = q15(sin(2 * M_PI * i / FFT_MAX_POINTS));
+    emit("static const int16_t fft_sin_q15[FFT_MAX_POINTS / 2]", table, half);
+
+    // First half of each window, the rest mirrors it: w(N - n) = w(n)
+    int refs[FFT_WINDOWS];
+    printf("static const int16_t fft_window_q15[FFT_WINDOWS][FFT_MAX_POINTS / 2 + 1] = {");
+    for (int w = 0; w < FFT_WINDOWS; w++) {
+        double gain = 0;
+        printf("\n    {");
+        for (int i = 0; i <= half; i++) {
+            int v = q15(window_at(w, 2 * M_PI * i / FFT_MAX_POINTS));
+            gain += (i == 0 || i == half ? 1 : 2) * v / Q15_ONE;
+            printf(i % PER_LINE ? " %d," : "\n        %d,", v);
+        }
+        printf("\n    },");
+        // A full-scale sine gives a bin of amplitude 0.5 * 32768 * gain
+        gain /= FFT_MAX_POINTS;
+        refs[w] = (int)lround(2000 * log10(Q15_ONE / 2 * gain));
+    }
+    printf("\n};\n\n");
+
+    printf("// Power of a full-scale sine's bin, centi-dB\n");
+    emit("static const int16_t fft_window_ref_cdb[FFT_WINDOWS]", refs, FFT_WINDOWS);
+
+    // Mid-point of each step, so dropping the lower bits is not biased
+    for (int i = 0; i < 256; i++) table[i] = (int)lround(1000 * log10(1 + (i + 0.5) / 256));
+    printf("// 10 log10(1 + f) for the 8 bits of f below a power's leading one, centi-dB\n");
+    emit("static const int16_t fft_log_frac_cdb[256]", table, 256);
+}
+
+// ============================================================================
+// Filters
+// ============================================================================
+
+/**
+ * Biquads from the Audio EQ Cookbook (R. Bristow-Johnson), normalised to
+ * a0 = 1 and printed as Q28
+ */
+static void emit_biquads(const char *name, const double (*s)[5], int sections) {
+    printf("static const biquad_coefs_t %s[%d] = {\n", name, sections);
+    for (int i = 0; i < sections; i++) {
+        long q[5];
+        for (int k = 0; k < 5; k++) q[k] = lround(s[i][k] * (1L << FILTER_COEF_SHIFT));
+        printf("    {%ld, %ld, %ld, %ld, %ld},\n", q[0], q[1], q[2], q[3], q[4]);
+    }
+    printf("};\n\n");
+}
+
+static void biquad(double *s, int type, double f0, double q) {
+    double w0 = 2 * M_PI * f0 / FILTER_RATE_HZ;
+    double c = cos(w0), alpha = sin(w0) / (2 * q);
+    double a0 = 1 + alpha;
+    if (type == FILTER_LOWPASS) {
+        s[0] = (1 - c) / 2; s[1] = 1 - c; s[2] = (1 - c) / 2;
+    } else if (type == FILTER_HIGHPASS) {
+        s[0] = (1 + c) / 2; s[1] = -(1 + c); s[2] = (1 + c) / 2;
+    } else {
+        s[0] = 1; s[1] = -2 * c; s[2] = 1;
+    }
+    s[3] = -2 * c;
+    s[4] = 1 - alpha;
+    for (int k = 0; k < 5; k++) s[k] /= a0;
+}
+
+/**
+ * Windowed-sinc low-pass, Blackman window. The first half and the
+ * centre tap are printed; the centre absorbs the rounding so the taps
+ * sum to exactly 1 and DC passes unchanged.
+ */
+static void emit_fir(const char *name, double cutoff_hz) {
+    const int n = FILTER_FIR_TAPS, mid = FILTER_FIR_TAPS / 2;
+    int taps[FILTER_FIR_TAPS / 2 + 1];
+    double h[FILTER_FIR_TAPS], sum = 0;
+    double fc = cutoff_hz / FILTER_RATE_HZ;
+    for (int i = 0; i < n; i++) {
+        double t = i - mid;
+        double sinc = t == 0 ? 2 * fc : sin(2 * M_PI * fc * t) / (M_PI * t);
+        double w = 0.42 - 0.5 * cos(2 * M_PI * i / (n - 1)) + 0.08 * cos(4 * M_PI * i / (n - 1));
+        h[i] = sinc * w;
+        sum += h[i];
+    }
+    int total = 0;
+    for (int i = 0; i < mid; i++) {
+        taps[i] = (int)lround(h[i] / sum * Q15_ONE);
+        total += 2 * taps[i];
+    }
+    taps[mid] = (int)Q15_ONE - total;
+    emit(name, taps, mid + 1);
+}
+
+static void emit_filters(void) {
+    double s[FILTER_MAX_SECTIONS][5];
+
+    // Butterworth: the sections' Q are 1 / (2 cos(k pi / 2n)) for order 2n
+    biquad(s[0], FILTER_LOWPASS, FILTER_LOWPASS_HZ, 1 / (2 * cos(M_PI / 8)));
+    biquad(s[1], FILTER_LOWPASS, FILTER_LOWPASS_HZ, 1 / (2 * cos(3 * M_PI / 8)));
+    emit_biquads("filter_lowpass_q28", s, 2);
+    biquad(s[0], FILTER_HIGHPASS, FILTER_HIGHPASS_HZ, M_SQRT1_2);
+    emit_biquads("filter_highpass_q28", s, 1);
+    biquad(s[0], FILTER_NOTCH50, 50, FILTER_NOTCH_Q);
+    biquad(s[1], FILTER_NOTCH50, 150, FILTER_NOTCH_Q);
+    emit_biquads("filter_notch50_q28", s, 2);
+    biquad(s[0], FILTER_NOTCH60, 60, FILTER_NOTCH_Q);
+    biquad(s[1], FILTER_NOTCH60, 180, FILTER_NOTCH_Q);
+    emit_biquads("filter_notch60_q28", s, 2);
+
+    emit_fir("static const int16_t filter_fir_low_q15[FILTER_FIR_TAPS / 2 + 1]", FILTER_FIR_LOW_HZ);
+    emit_fir("static const int16_t filter_fir_high_q15[FILTER_FIR_TAPS / 2 + 1]", FILTER_FIR_HIGH_HZ);
+}
+
+int main(void) {
+    printf("/**\n");
+    printf(" * dsp_tables.h - Generated by host/gen_tables.c, do not edit\n");
+    printf(" */\n\n");
+    printf("#ifndef DSP_TABLES_H\n#define DSP_TABLES_H\n\n");
+    printf("#include <stdint.h>\n#include \"fft.h\"\n#include \"filter.h\"\n\n");
+    emit_fft();
+    emit_filters();
+    printf("#endif // DSP_TABLES_H\n");
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * sim.h - Host simulation of the DTEK-V peripherals
+ *
+ * The firmware drivers are compiled with HOST_SIM defined and linked
+ * against these backends instead of the real hardware:
+ * - hal_read32/hal_write32 are dispatched by address (sim_mmio.c)
+ * - GPIO pins drive a simulated AD7705 (sim_ad7705.c)
+ * - The timer runs on a virtual clock (sim_timer.c)
+ * - The VGA frames are in-memory arrays behind a DMA controller (sim_vga.c)
+ *
+ * Time is virtual: it only advances when the firmware touches a
+ * peripheral or reads the cycle counter. Pure computation is
+ * free, so the simulation runs at full host speed and is deterministic.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+// Virtual CPU clock, same frequency as the board
+#define SIM_CLOCK_HZ        SYSTEM_CLOCK_FREQ
+
+// Approximate cost of one uncached I/O load/store on the softcore
+#define SIM_MMIO_CYCLES     2
+
+// One turn of a loop polling the cycle counter (csrr, compare, branch)
+#define SIM_CYCLE_POLL_CYCLES   3
+
+// Analog input source (sim_signal.c)
+typedef enum {
+    SIGNAL_SINE,
+    SIGNAL_SQUARE,
+    SIGNAL_TRIANGLE,
+    SIGNAL_SAW,
+    SIGNAL_DC,
+    SIGNAL_FILE
+} sim_shape_t;
+
+typedef struct {
+    sim_shape_t shape;
+    double freq;                // Hz, or playback rate for SIGNAL_FILE
+    double amplitude;           // Volts peak
+    double offset;              // Volts DC
+    double noise;               // Volts peak, uniform
+    double *samples;            // SIGNAL_FILE data
+    size_t count;
+} sim_signal_t;
+
+// Scripted change of the switches and buttons at a point in virtual time
+#define SIM_MAX_INPUT_EVENTS    32
+
+typedef struct {
+    uint64_t at;                // Virtual time, cycles
+    uint32_t switches;
+    uint32_t buttons;
+} sim_input_event_t;
+
+// Simulation settings, filled in from the command line by sim_main.c
+typedef struct {
+    uint64_t run_cycles;        // Stop after this much virtual time (0 = forever)
+    const char *ppm_path;       // Framebuffer dump written at exit (NULL = none)
+    sim_signal_t signal[2];     // Inputs on AIN1 and AIN2
+    double vref;                // AD7705 reference voltage
+    uint32_t switches;          // Value returned by the toggle switches
+    uint32_t buttons;           // Value returned by the push buttons
+    sim_input_event_t events[SIM_MAX_INPUT_EVENTS];    // In time order
+    int event_count;
+    bool quiet;                 // Suppress JTAG UART output
+} sim_config_t;
+
+extern sim_config_t sim_config;
+
+// Virtual clock
+uint64_t sim_now(void);
+void sim_advance(uint64_t cycles);
+double sim_seconds(uint64_t cycles);
+
+// GPIO backend
+uint32_t sim_gpio_read(void);
+void sim_gpio_write(uint32_t value);
+uint32_t sim_gpio_direction_read(void);
+void sim_gpio_direction_write(uint32_t value);
+
+// Timer backend (offset is relative to TIMER_BASE_ADDR)
+uint32_t sim_timer_read(uint32_t offset);
+void sim_timer_write(uint32_t offset, uint32_t value);
+
+// Interrupts: enable_interrupt() turns delivery on, after which a pending
+// timer timeout calls the firmware's handle_interrupt(TIMER_IRQ)
+void sim_irq_enable(void);
+void handle_interrupt(unsigned cause);
+
+// Analog inputs
+int sim_signal_parse(sim_signal_t *sig, const char *spec);
+double sim_signal_voltage(const sim_signal_t *sig, uint64_t t);
+
+// AD7705 bus and conversion statistics
+typedef struct {
+    uint32_t conversions;       // Conversion results produced
+    uint32_t samples;           // Data Register reads that returned fresh data
+    uint32_t stale_reads;       // Data Register reads with DRDY high
+    uint32_t overruns;          // Results overwritten before being read
+    uint32_t sclk_violations;   // SCLK phases shorter than the datasheet minimum
+    uint64_t sclk_cycles;       // Totals over all samples
+    uint64_t cs_assertions;
+    uint64_t cpu_cycles;
+    uint32_t sclk_min, sclk_max;        // Per-sample SCLK cycles
+    uint64_t cpu_min, cpu_max;          // Per-sample CPU cycles between reads
+    uint64_t sclk_min_half;             // Shortest SCLK phase seen, in CPU cycles
+    uint64_t sclk_period_total;         // Sum of rising-to-rising SCLK periods
+    uint64_t sclk_periods;              // within a CS frame, and their count
+} sim_ad7705_stats_t;
+
+// AD7705 model, driven by the GPIO pin levels
+void sim_ad7705_pins(uint32_t pins);
+uint32_t sim_ad7705_outputs(void);
+const sim_ad7705_stats_t *sim_ad7705_stats(void);
+void sim_ad7705_report(void);
+
+// VGA frames and pixel buffer DMA controller (offset is relative to VGA_DMA_BASE)
+#define SIM_VGA_FRAME_CYCLES    (SIM_CLOCK_HZ / 60)
+void sim_vga_mem_write(uint32_t offset, uint32_t value, int bytes);
+uint32_t sim_vga_dma_read(uint32_t offset);
+void sim_vga_dma_write(uint32_t offset, uint32_t value);
+void sim_vga_report(void);
+uint8_t sim_vga_pixel(int x, int y);
+int sim_vga_write_ppm(const char *path);
+
+// Benchmarks and self-checks, run with -B instead of the firmware
+void sim_bench_run(void);
+
+#endif // SIM_H
@@ -0,0 +1,468 @@
+/**
+ * sim_ad7705.c - Behavioral AD7705 model for the host build
+ *
+ * Sits on the simulated GPIO pins and speaks the same SPI Mode 3 protocol
+ * as the real part: DIN is sampled on rising SCLK edges, DOUT changes on
+ * falling edges, and every access starts with a write to the
+ * Communication Register. The model covers:
+ *
+ * - Register file: Communication, Setup, Clock, Data, and the per-channel
+ *   24-bit Offset and Gain calibration registers
+ * - Output rate from the Clock Register CLK/FS bits
+ * - Digital filter settling (3 update periods) after a Setup, Clock or
+ *   channel change, FSYNC and STBY
+ * - Self-calibration (6 periods) and zero/full-scale system calibration
+ * - DRDY: low when a result is ready, high after the Data Register is
+ *   read and for 500 MCLK periods before every output update
+ * - Interface reset after 32 consecutive ones on DIN
+ *
+ * Conversion results are taken from the AIN1/AIN2 signal sources at the
+ * instant of each output update. Bus activity is counted per sample so
+ * driver changes can be compared cycle for cycle.
+ */
+
+#include <stdio.h>
+#include "sim.h"
+#include "hardware.h"
+#include "ad7705_driver.h"
+
+#define SETTLE_PERIODS      3       // sinc3 filter settling
+#define SELF_CAL_PERIODS    6       // Zero-scale + full-scale internal calibration
+#define SYS_CAL_PERIODS     3       // One system calibration step
+#define DRDY_HIGH_MCLK      500     // DRDY high before each output update
+#define SCLK_MIN_HALF_NS    238     // Half period at the 2.1 MHz SCLK limit
+
+#define OFFSET_DEFAULT      0x1F4000
+#define GAIN_DEFAULT        0x5761AB
+
+typedef enum {
+    PHASE_COMM,                 // Waiting for a Communication Register write
+    PHASE_WRITE,                // Shifting in a register value
+    PHASE_READ                  // Shifting out a register value
+} phase_t;
+
+static struct {
+    // Pin state
+    bool cs_low;
+    bool sck;
+    bool dout;
+    uint64_t last_edge;         // Time of the last SCLK edge in this frame
+    uint64_t last_rising;       // Time of the last rising edge (0 = none yet)
+
+    // Serial interface
+    phase_t phase;
+    uint8_t reg;                // Register selected by the last comm write
+    uint8_t channel;            // Channel selected by the last comm write
+    bool standby;
+    uint32_t shift;
+    int bits;                   // Bits shifted so far in this phase
+    int width;                  // Register width of the current transfer
+    int ones;                   // Consecutive 1s on DIN (interface reset)
+    bool read_fresh;            // Current Data Register read has new data
+
+    // Register file
+    uint8_t setup;
+    uint8_t clock;
+    uint16_t data;
+    uint32_t offset[2];
+    uint32_t gain[2];
+
+    // Conversion engine
+    uint8_t conv_channel;       // Channel the modulator is converting
+    bool drdy;                  // true = DRDY asserted (low), data unread
+    bool converting;
+    uint64_t next_update;       // Time of the next output register update
+
+    // Per-sample bus accounting
+    bool have_mark;
+    uint64_t sclk_count, sclk_mark;
+    uint64_t cs_count, cs_mark;
+    uint64_t cpu_mark;
+
+    sim_ad7705_stats_t stats;
+} adc = {
+    .stats.sclk_min = UINT32_MAX,
+    .stats.cpu_min = UINT64_MAX,
+    .stats.sclk_min_half = UINT64_MAX,
+};
+
+static const int rates_clk0[4] = { 20, 25, 100, 200 };
+static const int rates_clk1[4] = { 50, 60, 250, 500 };
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+static uint64_t update_period(void) {
+    const int *rates = (adc.clock & 0x04) ? rates_clk1 : rates_clk0;
+    return SIM_CLOCK_HZ / rates[adc.clock & 0x03];
+}
+
+static uint64_t drdy_high_window(void) {
+    // CLK=1 assumes 2.4576 MHz at the modulator, CLK=0 assumes 1 MHz
+    uint64_t mclk = (adc.clock & 0x04) ? 2457600 : 1000000;
+    return DRDY_HIGH_MCLK * (uint64_t)SIM_CLOCK_HZ / mclk;
+}
+
+static bool drdy_asserted(void) {
+    if (!adc.drdy) return false;
+    return !(adc.converting && sim_now() + drdy_high_window() >= adc.next_update);
+}
+
+// ============================================================================
+// Transfer Function
+// ============================================================================
+
+/**
+ * Input as a fraction of the selected range: 0..1 unipolar, -1..1 bipolar
+ */
+static double input_fraction(uint8_t channel, uint64_t t) {
+    double v = sim_signal_voltage(&sim_config.signal[channel & 1], t);
+    double pga = (double)(1 << ((adc.setup >> 3) & 0x07));
+    return v * pga / sim_config.vref;
+}
+
+static uint16_t convert(uint8_t channel, uint64_t t) {
+    int pair = channel & 1;
+    double x = input_fraction(channel, t);
+
+    // Calibration registers shift and scale the transfer function
+    x -= ((double)adc.offset[pair] - OFFSET_DEFAULT) / (1 << 24);
+    x *= (double)adc.gain[pair] / GAIN_DEFAULT;
+
+    double code = (adc.setup & 0x04) ? x * 65536.0 : 32768.0 + x * 32768.0;
+    if (code < 0.0) code = 0.0;
+    if (code > 65535.0) code = 65535.0;
+    return (uint16_t)code;
+}
+
+// ============================================================================
+// Conversion Engine
+// ============================================================================
+
+static void power_on_reset(void) {
+    adc.phase = PHASE_COMM;
+    adc.bits = 0;
+    adc.ones = 0;
+    adc.standby = false;
+    adc.channel = 0;
+    adc.conv_channel = 0;
+    adc.setup = 0x01;           // FSYNC set, filter held in reset
+    adc.clock = 0x05;
+    adc.data = 0;
+    for (int i = 0; i < 2; i++) {
+        adc.offset[i] = OFFSET_DEFAULT;
+        adc.gain[i] = GAIN_DEFAULT;
+    }
+    adc.drdy = false;
+    adc.converting = false;
+}
+
+/**
+ * Finish a calibration cycle started by a Setup Register write
+ */
+static void finish_calibration(uint64_t t) {
+    int pair = adc.conv_channel & 1;
+    double x;
+
+    switch (adc.setup >> 6) {
+    case MODE_SELF_CAL:
+        adc.offset[pair] = OFFSET_DEFAULT;
+        adc.gain[pair] = GAIN_DEFAULT;
+        break;
+    case MODE_ZERO_SCALE_CAL:
+        // The present input becomes code zero
+        x = input_fraction(adc.conv_channel, t);
+        if (!(adc.setup & 0x04)) x += 1.0;
+        adc.offset[pair] = (uint32_t)(OFFSET_DEFAULT + x * (1 << 24)) & 0xFFFFFF;
+        break;
+    case MODE_FULL_SCALE_CAL:
+        // The present input becomes full scale
+        x = input_fraction(adc.conv_channel, t) -
+            ((double)adc.offset[pair] - OFFSET_DEFAULT) / (1 << 24);
+        if (x > 0.0) adc.gain[pair] = (uint32_t)(GAIN_DEFAULT / x) & 0xFFFFFF;
+        break;
+    }
+    adc.setup &= ~0xC0;         // Back to normal mode
+}
+
+/**
+ * Run the conversion engine up to the current virtual time
+ */
+static void update_conversions(void) {
+    uint64_t now = sim_now();
+    while (adc.converting && now >= adc.next_update) {
+        if (adc.setup >> 6) {
+            finish_calibration(adc.next_update);
+        }
+        if (adc.drdy) {
+            adc.stats.overruns++;
+        }
+        adc.data = convert(adc.conv_channel, adc.next_update);
+        adc.drdy = true;
+        adc.stats.conversions++;
+        adc.next_update += update_period();
+    }
+}
+
+static void restart_filter(void) {
+    adc.drdy = false;
+    if ((adc.setup & 0x01) || adc.standby) {
+        adc.converting = false;
+        return;
+    }
+
+    uint64_t periods;
+    switch (adc.setup >> 6) {
+    case MODE_SELF_CAL: periods = SELF_CAL_PERIODS; break;
+    case MODE_NORMAL:   periods = SETTLE_PERIODS; break;
+    default:            periods = SYS_CAL_PERIODS; break;
+    }
+    adc.converting = true;
+    adc.next_update = sim_now() + periods * update_period();
+}
+
+// ============================================================================
+// Register File
+// ============================================================================
+
+static int register_width(uint8_t reg) {
+    switch (reg) {
+    case REG_DATA:   return 16;
+    case REG_OFFSET:
+    case REG_GAIN:   return 24;
+    default:         return 8;
+    }
+}
+
+static uint32_t register_read(uint8_t reg) {
+    switch (reg) {
+    case REG_CMM:
+        return (drdy_asserted() ? 0x00 : 0x80) | (adc.reg << 4) |
+               (adc.standby ? 0x04 : 0) | adc.channel;
+    case REG_SETUP:  return adc.setup;
+    case REG_CLOCK:  return adc.clock;
+    case REG_DATA:   return adc.data;
+    case REG_OFFSET: return adc.offset[adc.channel & 1];
+    case REG_GAIN:   return adc.gain[adc.channel & 1];
+    default:         return 0;
+    }
+}
+
+static void register_write(uint8_t reg, uint32_t value) {
+    switch (reg) {
+    case REG_SETUP:
+        adc.setup = value & 0xFF;
+        restart_filter();
+        break;
+    case REG_CLOCK:
+        adc.clock = value & 0x1F;
+        restart_filter();
+        break;
+    case REG_OFFSET:
+        adc.offset[adc.channel & 1] = value & 0xFFFFFF;
+        break;
+    case REG_GAIN:
+        adc.gain[adc.channel & 1] = value & 0xFFFFFF;
+        break;
+    default:
+        break;
+    }
+}
+
+static void comm_write(uint8_t comm) {
+    adc.reg = (comm >> 4) & 0x07;
+    adc.channel = comm & 0x03;
+    adc.width = register_width(adc.reg);
+    adc.bits = 0;
+
+    bool standby = (comm & 0x04) != 0;
+    if (standby != adc.standby || (adc.channel & 1) != adc.conv_channel) {
+        adc.standby = standby;
+        adc.conv_channel = adc.channel & 1;
+        restart_filter();
+    }
+
+    if (comm & 0x08) {
+        adc.phase = PHASE_READ;
+        adc.shift = register_read(adc.reg);
+        if (adc.reg == REG_DATA) {
+            adc.read_fresh = drdy_asserted();
+        }
+    } else if (adc.reg == REG_NOP || adc.reg == REG_CMM) {
+        adc.phase = PHASE_COMM;
+    } else {
+        adc.phase = PHASE_WRITE;
+        adc.shift = 0;
+    }
+}
+
+// ============================================================================
+// Statistics
+// ============================================================================
+
+static void record_sample(void) {
+    sim_ad7705_stats_t *s = &adc.stats;
+    uint64_t now = sim_now();
+
+    if (adc.have_mark) {
+        uint32_t sclk = (uint32_t)(adc.sclk_count - adc.sclk_mark);
+        uint64_t cpu = now - adc.cpu_mark;
+
+        s->sclk_cycles += sclk;
+        s->cs_assertions += adc.cs_count - adc.cs_mark;
+        s->cpu_cycles += cpu;
+        if (sclk < s->sclk_min) s->sclk_min = sclk;
+        if (sclk > s->sclk_max) s->sclk_max = sclk;
+        if (cpu < s->cpu_min) s->cpu_min = cpu;
+        if (cpu > s->cpu_max) s->cpu_max = cpu;
+        s->samples++;
+    }
+
+    adc.have_mark = true;
+    adc.sclk_mark = adc.sclk_count;
+    adc.cs_mark = adc.cs_count;
+    adc.cpu_mark = now;
+}
+
+static void check_sclk_phase(void) {
+    uint64_t now = sim_now();
+    uint64_t half = now - adc.last_edge;
+    if (half < adc.stats.sclk_min_half) adc.stats.sclk_min_half = half;
+    if (half * 1000000000ULL < (uint64_t)SCLK_MIN_HALF_NS * SIM_CLOCK_HZ) {
+        adc.stats.sclk_violations++;
+    }
+    adc.last_edge = now;
+}
+
+// ============================================================================
+// Serial Interface
+// ============================================================================
+
+static void sck_falling(void) {
+    if (adc.phase == PHASE_READ) {
+        adc.dout = (adc.shift >> (adc.width - 1 - adc.bits)) & 1;
+    }
+}
+
+static void sck_rising(bool din) {
+    uint64_t now = sim_now();
+    adc.sclk_count++;
+    if (adc.last_rising != 0) {
+        adc.stats.sclk_period_total += now - adc.last_rising;
+        adc.stats.sclk_periods++;
+    }
+    adc.last_rising = now;
+
+    adc.ones = din ? adc.ones + 1 : 0;
+    if (adc.ones >= 32) {
+        adc.phase = PHASE_COMM;
+        adc.bits = 0;
+        return;
+    }
+
+    switch (adc.phase) {
+    case PHASE_COMM:
+        // A leading 1 is the 0/DRDY bit held high: stay on bit 0
+        if (adc.bits == 0 && din) break;
+        adc.shift = (adc.shift << 1) | din;
+        if (++adc.bits == 8) comm_write(adc.shift & 0xFF);
+        break;
+
+    case PHASE_WRITE:
+        adc.shift = (adc.shift << 1) | din;
+        if (++adc.bits == adc.width) {
+            register_write(adc.reg, adc.shift);
+            adc.phase = PHASE_COMM;
+            adc.bits = 0;
+        }
+        break;
+
+    case PHASE_READ:
+        if (++adc.bits == adc.width) {
+            if (adc.reg == REG_DATA) {
+                if (adc.read_fresh) {
+                    adc.drdy = false;
+                    record_sample();
+                } else {
+                    adc.stats.stale_reads++;
+                }
+            }
+            adc.phase = PHASE_COMM;
+            adc.bits = 0;
+        }
+        break;
+    }
+}
+
+/**
+ * Called on every GPIO write with the levels of the output pins
+ */
+void sim_ad7705_pins(uint32_t pins) {
+    update_conversions();
+
+    if ((pins & ADC_RST_PIN) == 0) {
+        power_on_reset();
+        adc.cs_low = false;
+        return;
+    }
+
+    bool cs_low = (pins & SPI_CS_PIN) == 0;
+    bool sck = (pins & SPI_SCK_PIN) != 0;
+
+    if (cs_low && !adc.cs_low) {
+        adc.cs_count++;
+        adc.last_edge = sim_now();
+        adc.last_rising = 0;
+    }
+
+    if (cs_low && adc.cs_low && sck != adc.sck) {
+        check_sclk_phase();
+        if (sck) {
+            sck_rising((pins & SPI_MOSI_PIN) != 0);
+        } else {
+            sck_falling();
+        }
+    }
+
+    adc.cs_low = cs_low;
+    adc.sck = sck;
+}
+
+/**
+ * Levels of the ADC output pins (DOUT and DRDY) as seen on the GPIO port
+ */
+uint32_t sim_ad7705_outputs(void) {
+    update_conversions();
+
+    uint32_t pins = 0;
+    if (adc.dout && adc.cs_low) pins |= SPI_MISO_PIN;
+    if (!drdy_asserted()) pins |= ADC_DRDY_PIN;
+    return pins;
+}
+
+const sim_ad7705_stats_t *sim_ad7705_stats(void) {
+    return &adc.stats;
+}
+
+void sim_ad7705_report(void) {
+    const sim_ad7705_stats_t *s = &adc.stats;
+
+    fprintf(stderr, "ad7705: %u conversions, %u samples read, %u overruns, %u stale reads\n",
+            s->conversions, s->samples, s->overruns, s->stale_reads);
+    if (s->samples == 0) return;
+
+    fprintf(stderr, "ad7705: per sample %.1f SCLK (%u..%u), %.1f CS, %.0f CPU cycles (%llu..%llu)\n",
+            (double)s->sclk_cycles / s->samples, s->sclk_min, s->sclk_max,
+            (double)s->cs_assertions / s->samples,
+            (double)s->cpu_cycles / s->samples,
+            (unsigned long long)s->cpu_min, (unsigned long long)s->cpu_max);
+    fprintf(stderr, "ad7705: shortest SCLK phase %llu cycles (%.0f ns), %u below %d ns\n",
+            (unsigned long long)s->sclk_min_half,
+            s->sclk_min_half * 1e9 / SIM_CLOCK_HZ, s->sclk_violations, SCLK_MIN_HALF_NS);
+    if (s->sclk_periods > 0) {
+        double period = (double)s->sclk_period_total / s->sclk_periods;
+        fprintf(stderr, "ad7705: SCLK %.1f cycles per bit within a frame (%.3f MHz)\n",
+                period, SIM_CLOCK_HZ / period / 1e6);
+    }
+}
@@ -0,0 +1,1230 @@
+/**
+ * sim_bench.c - Host-side benchmarks and self-checks for firmware code
+ *
+ * Run with -B instead of booting the firmware. Each bench calls the
+ * firmware routines directly, checks them against a reference and
+ * reports host timings. Host timings only compare alternatives relative
+ * to each other; the board has no FPU, so float references are far
+ * cheaper here than on the core.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "sim.h"
+#include "fixed.h"
+#include "trigger.h"
+#include "freqmeter.h"
+#include "ad7705_driver.h"
+#include "capture.h"
+#include "recorder.h"
+#include "phosphor.h"
+#include "sweep.h"
+#include "stats.h"
+#include "fft.h"
+#include "filter.h"
+#include "math_channel.h"
+#include "xy.h"
+#include "vga_driver.h"
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Keeps benchmark results alive so the loops are not optimised away
+static volatile uint32_t bench_sink;
+
+// ============================================================================
+// Fixed-point voltage readout
+// ============================================================================
+
+/**
+ * The float path the footer used before: volts from the raw code, then
+ * the digits peeled off with a float multiply and subtract each
+ */
+static int legacy_format_volts(char *buf, uint16_t raw, int dec) {
+    float val = (float)raw * VREF / 65535.0f;
+    int len = 0;
+    int ipart = (int)val;
+    float fpart = val - ipart;
+
+    if (ipart == 0) {
+        buf[len++] = '0';
+    } else {
+        char digits[6];
+        int i = 0;
+        while (ipart > 0) { digits[i++] = '0' + (ipart % 10); ipart /= 10; }
+        while (i > 0) buf[len++] = digits[--i];
+    }
+    if (dec > 0) {
+        buf[len++] = '.';
+        for (int d = 0; d < dec; d++) {
+            fpart *= 10;
+            int digit = (int)fpart;
+            buf[len++] = '0' + digit;
+            fpart -= digit;
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Exact reference: raw * VREF / 65535 truncated to centivolts, in
+ * integer arithmetic
+ */
+static void exact_format_volts(char *buf, uint16_t raw) {
+    uint32_t cv = (uint32_t)((uint64_t)raw * VREF_MV / 10 / 65535);
+    sprintf(buf, "%u.%02u", cv / 100, cv % 100);
+}
+
+static void bench_fixed_readout(void) {
+    char a[FIXED_FORMAT_MAX + 8], b[FIXED_FORMAT_MAX], ref[FIXED_FORMAT_MAX + 8];
+    int float_wrong = 0, fixed_wrong = 0;
+
+    for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+        exact_format_volts(ref, raw);
+        legacy_format_volts(a, raw, 2);
+        fixed_format(b, ad7705_raw_to_uv(raw), 6, 2);
+        if (strcmp(a, ref) != 0) float_wrong++;
+        if (strcmp(b, ref) != 0) {
+            if (fixed_wrong++ == 0) {
+                printf("fixed readout: code %u reads \"%s\", exact \"%s\"\n", raw, b, ref);
+            }
+        }
+    }
+    printf("fixed readout: %s, %d of 65536 codes wrong in the last digit (float path: %d)\n",
+           fixed_wrong == 0 ? "ok" : "FAIL", fixed_wrong, float_wrong);
+
+    const int rounds = 20;
+    double t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+            bench_sink += legacy_format_volts(a, raw, 2);
+        }
+    }
+    double t1 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+            bench_sink += fixed_format(b, ad7705_raw_to_uv(raw), 6, 2);
+        }
+    }
+    double t2 = now_ns();
+    double n = rounds * 65536.0;
+    printf("fixed readout: convert+format %.1f ns float, %.1f ns fixed (host)\n",
+           (t1 - t0) / n, (t2 - t1) / n);
+}
+
+// ============================================================================
+// Edge trigger
+// ============================================================================
+
+#define TRIG_SAMPLES    20000
+#define TRIG_PERIOD     97
+
+/**
+ * Trigger on a sawtooth at every pre-trigger length, up to and past the
+ * record length, feeding the capture first as the main loop does. Each
+ * record, read from the capture where it completes, must be the last
+ * record_len samples with the crossing at the clamped pre-trigger index,
+ * and records must keep coming: one per record length plus two periods.
+ */
+static void bench_trigger(void) {
+    static uint16_t x[TRIG_SAMPLES], rec[TRIG_RECORD_MAX];
+    const uint16_t len = 320, level = 30000;
+    const uint16_t pres[] = { 0, 1, 160, 318, 319, 320, 1000 };
+    int wrong = 0, starved = 0, records = 0;
+
+    for (int i = 0; i < TRIG_SAMPLES; i++) x[i] = (uint16_t)(i % TRIG_PERIOD * 600);
+
+    for (size_t k = 0; k < sizeof pres / sizeof pres[0]; k++) {
+        trigger_config_t cfg = {
+            .level = level, .hysteresis = 1000, .edge = TRIG_EDGE_RISING,
+            .mode = TRIG_MODE_NORMAL, .record_len = len, .pre_samples = pres[k],
+            .holdoff = 0, .auto_timeout = UINT32_MAX,
+        };
+        int pre = pres[k] < len ? pres[k] : len - 1;
+        int got = 0;
+        trigger_init(&cfg);
+        capture_reset();
+        for (int i = 0; i < TRIG_SAMPLES; i++) {
+            capture_feed(x[i]);
+            if (!trigger_feed(x[i])) continue;
+            got++;
+            if (capture_read(0, capture_count(), len, rec) != len ||
+                memcmp(rec, &x[i + 1 - len], len * sizeof *rec) ||
+                rec[pre] < level || (pre > 0 && rec[pre - 1] >= level)) {
+                if (wrong++ == 0) printf("trigger: pre %u record at sample %d is wrong\n", pres[k], i);
+            }
+        }
+        if (got < TRIG_SAMPLES / (len + 2 * TRIG_PERIOD)) {
+            if (starved++ == 0) printf("trigger: pre %u gave only %d records\n", pres[k], got);
+        }
+        records += got;
+    }
+    printf("trigger: %s, %d records at pre-trigger 0..1000 of %u, %d wrong, %d lengths stalled\n",
+           wrong == 0 && starved == 0 ? "ok" : "FAIL", records, len, wrong, starved);
+}
+
+// ============================================================================
+// Frequency meter
+// ============================================================================
+
+#define FREQ_GATE       20000   // Samples per measured gate
+#define FREQ_RATE_MHZ   500000
+
+typedef struct {
+    bool square;
+    double period;              // Samples
+    double duty;                // High fraction, squares only
+} freq_case_t;
+
+/**
+ * Sample i of a noisy sine or square of the case, ~80% of full scale
+ */
+static uint16_t freq_signal(const freq_case_t *c, int i) {
+    double phase = fmod(i / c->period + 0.3, 1.0);
+    double v = c->square ? (phase < c->duty ? 1 : -1) : sin(2 * M_PI * phase);
+    return (uint16_t)lround(32768 + 26000 * v + rand() % 1601 - 800);
+}
+
+/**
+ * Sines and squares at whole and fractional periods, with noise well
+ * inside the hysteresis band. After a gate of FREQ_GATE samples the
+ * period must be within 0.05% and the duty within 3 permille plus a
+ * sample's worth of the period. Gates of about four periods of the
+ * sines must still be within 0.5%, which only holds if crossings are
+ * interpolated between samples. Then the staleness rule: a flat input
+ * keeps the last result for a while and drops it after
+ * FREQ_STALE_SAMPLES, and a swing under FREQ_MIN_SWING never reports.
+ */
+static void bench_freqmeter(void) {
+    const freq_case_t cases[] = {
+        { false, 10.0, 0.5 }, { false, 23.7, 0.5 }, { false, 61.37, 0.5 }, { false, 157.9, 0.5 },
+        { true, 12.0, 0.5 }, { true, 31.4, 0.25 }, { true, 77.7, 0.7 }, { true, 203.3, 0.1 },
+    };
+    freq_result_t res;
+    int wrong = 0;
+    double worst_ppm = 0, worst_duty = 0, worst_short_ppm = 0;
+
+    srand(8);
+    for (size_t k = 0; k < sizeof cases / sizeof cases[0]; k++) {
+        const freq_case_t *c = &cases[k];
+        freq_reset();
+        int i = 0;
+        for (; i < 1000; i++) freq_feed(freq_signal(c, i));
+        freq_read(&res);    // Starts a fresh gate
+        for (; i < 1000 + FREQ_GATE; i++) freq_feed(freq_signal(c, i));
+
+        if (!freq_read(&res)) {
+            if (wrong++ == 0) printf("freqmeter: no result for period %.2f\n", c->period);
+            continue;
+        }
+        double period = res.period_q16 / 65536.0;
+        double ppm = fabs(period / c->period - 1) * 1e6;
+        double duty_err = fabs(res.duty_permille - c->duty * 1000);
+        double mhz = FREQ_RATE_MHZ / c->period;
+        double mhz_err = fabs(freq_to_millihertz(&res, FREQ_RATE_MHZ) - mhz);
+        if (ppm > worst_ppm) worst_ppm = ppm;
+        if (duty_err > worst_duty) worst_duty = duty_err;
+        if (ppm > 500 || duty_err > 3 + 1000 / c->period || mhz_err > mhz * 500e-6 + 1) {
+            if (wrong++ == 0) {
+                printf("freqmeter: %s period %.2f duty %.2f read %.3f, %u permille\n",
+                       c->square ? "square" : "sine", c->period, c->duty, period, res.duty_permille);
+            }
+        }
+
+        // Short gates, where a whole-sample edge time would be off by up
+        // to a quarter of a period's worth
+        for (int g = 0; g < 50 && !c->square; g++) {
+            int end = i + (int)(4 * c->period);
+            for (; i < end; i++) freq_feed(freq_signal(c, i));
+            if (!freq_read(&res)) continue;
+            double e = fabs(res.period_q16 / 65536.0 / c->period - 1) * 1e6;
+            if (e > worst_short_ppm) worst_short_ppm = e;
+            if (e > 5000 && wrong++ == 0) {
+                printf("freqmeter: period %.2f short gate read %.3f\n", c->period, res.period_q16 / 65536.0);
+            }
+        }
+
+        // Flat input: the last result holds, then goes stale
+        for (int j = 0; j < FREQ_STALE_SAMPLES / 2; j++) freq_feed(32768);
+        if (!freq_read(&res)) wrong++;
+        for (int j = 0; j < FREQ_STALE_SAMPLES; j++) freq_feed(32768);
+        if (freq_read(&res)) wrong++;
+    }
+
+    // Too small a swing to be a signal
+    freq_reset();
+    for (int i = 0; i < FREQ_GATE; i++) {
+        freq_feed((uint16_t)lround(32768 + FREQ_MIN_SWING / 3 * sin(2 * M_PI * i / 40.0)));
+    }
+    if (freq_read(&res)) wrong++;
+
+    printf("freqmeter: %s, periods within %.0f ppm (%.0f ppm over 4-period gates), "
+           "duty within %.1f permille\n",
+           wrong == 0 ? "ok" : "FAIL", worst_ppm, worst_short_ppm, worst_duty);
+}
+
+// ============================================================================
+// Deep capture min/max view
+// ============================================================================
+
+#define VIEW_COLUMNS    318
+#define VIEW_SAMPLES    (CAPTURE_DEPTH + CAPTURE_DEPTH / 3)
+
+/**
+ * Brute-force reference for capture_view(): scan every sample in view
+ */
+static void scan_view(const uint16_t *all, uint32_t start, uint32_t span,
+                      uint16_t *mins, uint16_t *maxs) {
+    for (int c = 0; c < VIEW_COLUMNS; c++) {
+        uint32_t a = start + (uint32_t)((uint64_t)span * c / VIEW_COLUMNS);
+        uint32_t b = start + (uint32_t)((uint64_t)span * (c + 1) / VIEW_COLUMNS);
+        if (b <= a) b = a + 1;
+        uint16_t lo = 0xFFFF, hi = 0;
+        for (uint32_t i = a; i < b; i++) {
+            if (all[i] < lo) lo = all[i];
+            if (all[i] > hi) hi = all[i];
+        }
+        mins[c] = lo;
+        maxs[c] = hi;
+    }
+}
+
+/**
+ * Brute-force reference for capture_view_mean(): rounded column means
+ */
+static void scan_mean(const uint16_t *all, uint32_t start, uint32_t span, uint16_t *means) {
+    for (int c = 0; c < VIEW_COLUMNS; c++) {
+        uint32_t a = start + (uint32_t)((uint64_t)span * c / VIEW_COLUMNS);
+        uint32_t b = start + (uint32_t)((uint64_t)span * (c + 1) / VIEW_COLUMNS);
+        if (b <= a) b = a + 1;
+        uint64_t sum = 0;
+        for (uint32_t i = a; i < b; i++) sum += all[i];
+        means[c] = (uint16_t)((sum + (b - a) / 2) / (b - a));
+    }
+}
+
+/**
+ * Random walk with single-sample glitches to either rail, fed past the
+ * capture depth so the rings have wrapped. Every zoom level and a spread
+ * of pan positions must match the brute-force scan exactly, so no
+ * glitch can disappear in the decimation. Column means must match too.
+ */
+static void bench_capture_view(void) {
+    static uint16_t all[VIEW_SAMPLES];
+    uint16_t mins[VIEW_COLUMNS], maxs[VIEW_COLUMNS];
+    uint16_t ref_min[VIEW_COLUMNS], ref_max[VIEW_COLUMNS];
+    int32_t v = 32768;
+    
+    srand(1);
+    capture_reset();
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < VIEW_SAMPLES; i++) {
+        v += rand() % 513 - 256;
+        if (v < 0) v = 0;
+        if (v > 65535) v = 65535;
+        all[i] = (i % 997 == 0) ? (i & 1 ? 65535 : 0) : (uint16_t)v;
+        capture_feed(all[i]);
+    }
+    double t1 = now_ns();
+    
+    int views = 0, wrong = 0, means_wrong = 0;
+    uint32_t oldest = capture_oldest();
+    for (int zoom = 0; (VIEW_COLUMNS << zoom) <= (int)CAPTURE_DEPTH; zoom++) {
+        uint32_t span = VIEW_COLUMNS << zoom;
+        for (int p = 0; p < 64; p++) {
+            uint32_t start = oldest + (uint32_t)((uint64_t)(CAPTURE_DEPTH - span) * p / 63);
+            capture_view(0, start + span, span, VIEW_COLUMNS, mins, maxs);
+            scan_view(all, start, span, ref_min, ref_max);
+            views++;
+            if (memcmp(mins, ref_min, sizeof mins) || memcmp(maxs, ref_max, sizeof maxs)) {
+                if (wrong++ == 0) {
+                    printf("capture view: zoom %d start %u differs from the scan\n", zoom, start);
+                }
+            }
+            capture_view_mean(0, start + span, span, VIEW_COLUMNS, mins, maxs);
+            scan_mean(all, start, span, ref_min);
+            if (memcmp(mins, ref_min, sizeof mins) || memcmp(maxs, ref_min, sizeof maxs)) {
+                if (means_wrong++ == 0) {
+                    printf("capture view: zoom %d start %u means differ from the scan\n", zoom, start);
+                }
+            }
+        }
+    }
+    printf("capture view: %s, %d of %d views differ from a full scan\n",
+           wrong == 0 ? "ok" : "FAIL", wrong, views);
+    printf("capture view: %s, %d of %d mean views differ from a full scan\n",
+           means_wrong == 0 ? "ok" : "FAIL", means_wrong, views);
+    
+    // Widest view: one column per 512+ samples
+    uint32_t span = VIEW_COLUMNS << 9;
+    const int rounds = 200;
+    double t2 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        capture_view(0, oldest + r + span, span, VIEW_COLUMNS, mins, maxs);
+        bench_sink += mins[r % VIEW_COLUMNS];
+    }
+    double t3 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        scan_view(all, oldest + r, span, mins, maxs);
+        bench_sink += mins[r % VIEW_COLUMNS];
+    }
+    double t4 = now_ns();
+    printf("capture view: feed %.1f ns/sample; %u-sample view %.0f ns pyramid, %.0f ns scan (host)\n",
+           (t1 - t0) / VIEW_SAMPLES, span, (t3 - t2) / rounds, (t4 - t3) / rounds);
+}
+
+// ============================================================================
+// Recorder codec
+// ============================================================================
+
+#define CODEC_SAMPLES   (1 << 18)
+
+/**
+ * Every sample code after a spread of previous codes, including both
+ * ends of the range, must decode back to itself in the expected length
+ */
+static int check_codec_exhaustive(void) {
+    uint8_t buf[RECORDER_MAX_SAMPLE_BYTES + 1];
+    uint16_t prevs[72] = { 0, 1, 32767, 32768, 65534, 65535 };
+    int wrong = 0;
+
+    srand(2);
+    for (int i = 6; i < 72; i++) prevs[i] = (uint16_t)rand();
+
+    for (int p = 0; p < 72; p++) {
+        for (uint32_t code = 0; code <= 0xFFFF; code++) {
+            int16_t delta = (int16_t)(uint16_t)(code - prevs[p]);
+            int mag = delta < 0 ? -(delta + 1) : delta;
+            int expect = mag < 64 ? 1 : mag < 8192 ? 2 : 3;
+            uint16_t back;
+            int n = recorder_encode(buf, prevs[p], (uint16_t)code);
+            int m = recorder_decode(buf, prevs[p], &back);
+            if (n != expect || m != n || back != code) {
+                if (wrong++ == 0) {
+                    printf("recorder codec: %u after %u: %d bytes, decoded %u in %d\n",
+                           code, prevs[p], n, back, m);
+                }
+            }
+        }
+    }
+    return wrong;
+}
+
+/**
+ * Record a simulated input through the recorder API, replay it twice
+ * round (replay wraps) and compare. Returns the mismatches; the ratio
+ * and host costs are printed.
+ */
+static int check_codec_stream(const char *spec) {
+    static uint16_t in[CODEC_SAMPLES], out[CODEC_SAMPLES];
+    sim_signal_t sig = { 0 };
+    if (sim_signal_parse(&sig, spec) != 0) return 1;
+
+    for (int i = 0; i < CODEC_SAMPLES; i++) {
+        double v = sim_signal_voltage(&sig, (uint64_t)i * SIM_CLOCK_HZ / 500);
+        double code = v / sim_config.vref * 65535.0 + 0.5;
+        in[i] = code < 0 ? 0 : code > 65535 ? 65535 : (uint16_t)code;
+    }
+
+    double t0 = now_ns();
+    recorder_start();
+    for (int i = 0; i < CODEC_SAMPLES; i++) recorder_put(in[i]);
+    recorder_stop(500000);
+    double t1 = now_ns();
+
+    int wrong = 0;
+    for (int round = 0; round < 2; round++) {
+        recorder_read(out, CODEC_SAMPLES);
+        wrong += memcmp(in, out, sizeof in) != 0;
+    }
+    double t2 = now_ns();
+
+    recorder_stats_t st;
+    recorder_get_stats(&st);
+    printf("recorder codec: %-26s ratio %.2f, %.2f bytes/sample, encode %.1f ns, decode %.1f ns (host)\n",
+           spec, 2.0 * st.samples / st.bytes, (double)st.bytes / st.samples,
+           (t1 - t0) / CODEC_SAMPLES, (t2 - t1) / (2.0 * CODEC_SAMPLES));
+    return wrong;
+}
+
+static void bench_recorder_codec(void) {
+    static const char *specs[] = {
+        "dc:1.65:0:0:0.002",
+        "sine:0.5:1.0:1.65:0.002",
+        "sine:5:1.0:1.65",
+        "sine:5:1.0:1.65:0.02",
+        "square:23:1.0:1.65",
+        "dc:1.65:0:0:1.6",
+    };
+    int wrong = check_codec_exhaustive();
+    printf("recorder codec: %s, %d of %d encodings do not round-trip\n",
+           wrong == 0 ? "ok" : "FAIL", wrong, 72 * 65536);
+
+    int streams_wrong = 0;
+    for (size_t i = 0; i < sizeof specs / sizeof specs[0]; i++) {
+        streams_wrong += check_codec_stream(specs[i]);
+    }
+    printf("recorder codec: %s, %d stream replays differ\n",
+           streams_wrong == 0 ? "ok" : "FAIL", streams_wrong);
+}
+
+// ============================================================================
+// Persistence display
+// ============================================================================
+
+#define PHOSPHOR_FRAMES 400
+
+/**
+ * One noisy sine envelope per screen column, shifted by a random phase
+ * so successive sweeps spread over the area like a jittery trigger
+ */
+static void noisy_envelope(uint16_t *mins, uint16_t *maxs) {
+    int phase = rand() % 7;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        double v = 32768 + 26000 * sin((x + phase) * 2 * M_PI / 106);
+        int lo = (int)v - rand() % 1500, hi = (int)v + rand() % 1500;
+        mins[x] = lo < 0 ? 0 : lo;
+        maxs[x] = hi > 65535 ? 65535 : hi;
+    }
+}
+
+/**
+ * The word-at-a-time decay must match the per-byte rule
+ * c - (c >> shift) - (c != 0) on every count, for every shift in use.
+ * Then the cost of a persistence frame (decay, add a sweep, paint the
+ * area) is compared with a plain one (grid and envelope).
+ */
+static void bench_phosphor(void) {
+    static uint8_t before[PHOSPHOR_WIDTH * PHOSPHOR_HEIGHT];
+    uint16_t mins[SCREEN_WIDTH], maxs[SCREEN_WIDTH];
+    int left, right;
+    int wrong = 0, checked = 0;
+    
+    vga_get_waveform_bounds(0, 0, &left, &right);
+    srand(3);
+    phosphor_clear();
+    for (int shift = 1; shift <= 4; shift++) {
+        for (int round = 0; round < 20; round++) {
+            noisy_envelope(mins, maxs);
+            phosphor_add_envelope(mins, maxs, left, right);
+            memcpy(before, phosphor_counts(), sizeof before);
+            phosphor_decay(shift);
+            const uint8_t *after = phosphor_counts();
+            for (size_t i = 0; i < sizeof before; i++) {
+                uint8_t c = before[i];
+                uint8_t expect = c - (c >> shift) - (c != 0);
+                if (after[i] != expect) wrong++;
+                checked += c != 0;
+            }
+        }
+    }
+    printf("phosphor decay: %s, %d of %d nonzero counts differ from the per-byte rule\n",
+           wrong == 0 ? "ok" : "FAIL", wrong, checked);
+    
+    static uint16_t sweeps_min[16][SCREEN_WIDTH], sweeps_max[16][SCREEN_WIDTH];
+    for (int i = 0; i < 16; i++) noisy_envelope(sweeps_min[i], sweeps_max[i]);
+    
+    phosphor_clear();
+    double t0 = now_ns();
+    for (int f = 0; f < PHOSPHOR_FRAMES; f++) {
+        phosphor_decay(PHOSPHOR_DECAY_SHIFT);
+    }
+    double t1 = now_ns();
+    for (int f = 0; f < PHOSPHOR_FRAMES; f++) {
+        phosphor_decay(PHOSPHOR_DECAY_SHIFT);
+        phosphor_add_envelope(sweeps_min[f & 15], sweeps_max[f & 15], left, right);
+    }
+    double t2 = now_ns();
+    for (int f = 0; f < PHOSPHOR_FRAMES; f++) {
+        phosphor_draw();
+    }
+    double t3 = now_ns();
+    for (int f = 0; f < PHOSPHOR_FRAMES; f++) {
+        vga_draw_grid();
+        vga_draw_envelope(sweeps_min[f & 15], sweeps_max[f & 15], left, right, COLOR_WAVEFORM);
+    }
+    double t4 = now_ns();
+    
+    int lit = 0;
+    const uint8_t *counts = phosphor_counts();
+    for (int i = 0; i < PHOSPHOR_WIDTH * PHOSPHOR_HEIGHT; i++) lit += counts[i] != 0;
+    printf("phosphor frame: decay %.1f us empty, decay+sweep %.1f us, paint %.1f us; "
+           "plain grid+trace %.1f us (host, %d%% of the area lit)\n",
+           (t1 - t0) / PHOSPHOR_FRAMES / 1000, (t2 - t1) / PHOSPHOR_FRAMES / 1000,
+           (t3 - t2) / PHOSPHOR_FRAMES / 1000, (t4 - t3) / PHOSPHOR_FRAMES / 1000,
+           lit * 100 / (PHOSPHOR_WIDTH * PHOSPHOR_HEIGHT));
+    phosphor_clear();
+}
+
+// ============================================================================
+// Sweep averaging and envelope
+// ============================================================================
+
+#define SWEEP_ROUNDS    64
+
+/**
+ * Add noisy sweeps whose columns fill from the left over the first
+ * sweeps, as while the capture fills, with some columns empty at random
+ * after that. After every sweep each column is checked against all the
+ * sweeps kept in full: while a column has fewer than SWEEP_AVERAGE
+ * sweeps its average must be their rounded mean exactly, from then on
+ * within a code of the same exponential average in double, and the
+ * envelope must be their exact min and max.
+ */
+static void bench_sweep(void) {
+    static uint16_t mins[SWEEP_ROUNDS][SWEEP_COLUMNS], maxs[SWEEP_ROUNDS][SWEEP_COLUMNS];
+    uint16_t avg_min[SWEEP_COLUMNS], avg_max[SWEEP_COLUMNS];
+    uint16_t env_min[SWEEP_COLUMNS], env_max[SWEEP_COLUMNS];
+    const int left = 1, right = SWEEP_COLUMNS - 2;
+    int wrong = 0, plain = 0, running = 0;
+    double worst = 0;
+
+    srand(9);
+    for (int r = 0; r < SWEEP_ROUNDS; r++) {
+        int filled = left + (right - left) * (r + 1) / 8;
+        for (int x = 0; x < SWEEP_COLUMNS; x++) {
+            if (x < left || x > right || x > filled || rand() % 20 == 0) {
+                mins[r][x] = 0xFFFF;
+                maxs[r][x] = 0;
+                continue;
+            }
+            int v = 30000 + (int)(20000 * sin(x / 20.0)) + rand() % 6001 - 3000;
+            int spread = rand() % 2000;
+            mins[r][x] = (uint16_t)(v - spread);
+            maxs[r][x] = (uint16_t)(v + rand() % 2000);
+        }
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        sweep_reset();
+        for (int r = 0; r < SWEEP_ROUNDS; r++) {
+            if (pass == 0) {
+                sweep_add_average(mins[r], maxs[r], left, right);
+                sweep_get_average(avg_min, avg_max, left, right);
+            } else {
+                sweep_add_envelope(mins[r], maxs[r], left, right);
+                sweep_get_envelope(env_min, env_max, left, right);
+            }
+            if (sweep_count() != (uint32_t)r + 1) wrong++;
+
+            for (int x = left; x <= right; x++) {
+                int n = 0;
+                uint32_t sum = 0;
+                double ema = 0;
+                uint16_t lo = 0xFFFF, hi = 0;
+                for (int k = 0; k <= r; k++) {
+                    if (mins[k][x] > maxs[k][x]) continue;
+                    uint32_t v = ((uint32_t)mins[k][x] + maxs[k][x] + 1) >> 1;
+                    if (n < SWEEP_AVERAGE) sum += v;
+                    else ema += (v - ema) / SWEEP_AVERAGE;
+                    if (++n == SWEEP_AVERAGE) ema = (double)sum / SWEEP_AVERAGE;
+                    if (mins[k][x] < lo) lo = mins[k][x];
+                    if (maxs[k][x] > hi) hi = maxs[k][x];
+                }
+                if (pass == 1) {
+                    if (env_min[x] != lo || env_max[x] != hi) wrong++;
+                } else if (n == 0) {
+                    if (avg_min[x] <= avg_max[x]) wrong++;
+                } else if (n < SWEEP_AVERAGE) {
+                    plain++;
+                    if (avg_min[x] != avg_max[x] || avg_min[x] != (sum + n / 2) / n) wrong++;
+                } else {
+                    running++;
+                    double d = fabs(avg_min[x] - ema);
+                    if (d > worst) worst = d;
+                    if (avg_min[x] != avg_max[x] || d > 1) wrong++;
+                }
+            }
+        }
+    }
+    printf("sweep: %s, %d plain-mean and %d running-average columns checked, within %.2f codes; "
+           "envelope exact\n", wrong == 0 ? "ok" : "FAIL", plain, running, worst);
+    sweep_reset();
+}
+
+// ============================================================================
+// Incremental statistics
+// ============================================================================
+
+#define STATS_SAMPLES   (1 << 16)
+
+/**
+ * Microvolt measurements straight from the samples in double precision
+ */
+static void reference_stats(const uint16_t *x, int n, double *mean, double *rms,
+                            double *ac, double *sd) {
+    double sum = 0, sumsq = 0;
+    for (int i = 0; i < n; i++) {
+        sum += x[i];
+        sumsq += (double)x[i] * x[i];
+    }
+    double m = sum / n;
+    double var = 0;
+    for (int i = 0; i < n; i++) var += (x[i] - m) * (x[i] - m);
+    double uv = VREF_MV * 1000.0 / 65535;
+    *mean = m * uv;
+    *rms = sqrt(sumsq / n) * uv;
+    *ac = sqrt(var / n) * uv;
+    *sd = sqrt(var / (n - 1)) * uv;
+}
+
+/**
+ * Feed a noisy signal with bursts of glitches. After every sample the
+ * sliding window's sums and min/max positions must match a scan of the
+ * last STATS_WINDOW samples; at intervals every measurement is compared
+ * with a double-precision reference, allowing 2 uV of truncation.
+ */
+static void bench_stats(void) {
+    static uint16_t x[STATS_SAMPLES];
+    static stats_window_t w;
+    stats_sums_t sums;
+    int wrong = 0, worst_uv = 0, compared = 0;
+    
+    srand(4);
+    for (int i = 0; i < STATS_SAMPLES; i++) {
+        int v = 32768 + (int)(20000 * sin(i * 0.05)) + rand() % 2001 - 1000;
+        if (i % 1543 < 3) v = rand() & 0xFFFF;
+        x[i] = (uint16_t)v;
+    }
+    
+    stats_window_reset(&w);
+    for (int i = 0; i < STATS_SAMPLES; i++) {
+        stats_window_feed(&w, x[i]);
+        stats_window_sums(&w, &sums);
+        
+        int first = i + 1 > STATS_WINDOW ? i + 1 - STATS_WINDOW : 0;
+        uint64_t sum = 0, sumsq = 0;
+        uint16_t lo = 0xFFFF, hi = 0;
+        for (int j = first; j <= i; j++) {
+            sum += x[j];
+            sumsq += (uint32_t)x[j] * x[j];
+            if (x[j] < lo) lo = x[j];
+            if (x[j] > hi) hi = x[j];
+        }
+        if (sums.n != (uint32_t)(i + 1 - first) || sums.sum != sum || sums.sumsq != sumsq ||
+            sums.min != lo || sums.max != hi || x[sums.min_at] != lo || x[sums.max_at] != hi ||
+            (int)sums.min_at < first || (int)sums.max_at < first) {
+            if (wrong++ == 0) printf("stats window: sample %d differs from a scan\n", i);
+        }
+        
+        if (i % 997 == 996) {
+            double mean, rms, ac, sd;
+            reference_stats(&x[first], i + 1 - first, &mean, &rms, &ac, &sd);
+            stats_result_t r;
+            stats_compute(&sums, &r);
+            double err[4] = { r.mean_uv - mean, r.rms_uv - rms, r.ac_rms_uv - ac, r.std_dev_uv - sd };
+            for (int k = 0; k < 4; k++) {
+                int e = (int)fabs(err[k]) + 1;
+                if (e > worst_uv) worst_uv = e;
+                if (fabs(err[k]) > 2) wrong++;
+            }
+            compared++;
+        }
+    }
+    printf("stats window: %s, %d mismatches over %d samples, %d checkpoints within %d uV of double\n",
+           wrong == 0 ? "ok" : "FAIL", wrong, STATS_SAMPLES, compared, worst_uv);
+    
+    const int rounds = 20;
+    stats_sums_t sweep;
+    stats_sums_reset(&sweep);
+    double t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < STATS_SAMPLES; i++) stats_sums_feed(&sweep, x[i], i);
+    }
+    double t1 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < STATS_SAMPLES; i++) stats_window_feed(&w, x[i]);
+    }
+    double t2 = now_ns();
+    for (int r = 0; r < rounds * 1000; r++) {
+        bench_sink += stats_value(&sweep, r % STATS_COUNT);
+    }
+    double t3 = now_ns();
+    double n = (double)rounds * STATS_SAMPLES;
+    printf("stats: feed %.1f ns sweep, %.1f ns window; one measurement %.0f ns (host)\n",
+           (t1 - t0) / n, (t2 - t1) / n, (t3 - t2) / (rounds * 1000));
+}
+
+// ============================================================================
+// Fixed-point FFT
+// ============================================================================
+
+#define FFT_TRIALS      6
+#define FFT_CHECK_RANGE_DB 50  // Spectrum bins compared, below the peak
+
+// Same cosine-sum windows as gen_tables.c, evaluated in double
+static const double fft_ref_terms[FFT_WINDOWS][5] = {
+    [FFT_WINDOW_HANN]     = {0.5, 0.5},
+    [FFT_WINDOW_BLACKMAN] = {0.42, 0.5, 0.08},
+    [FFT_WINDOW_FLATTOP]  = {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368},
+    [FFT_WINDOW_RECT]     = {1.0},
+};
+
+/**
+ * Bins 0..n/2-1 of the DFT of x, divided by n, straight from the sums
+ */
+static void reference_dft(const double *x, int n, double *re, double *im) {
+    for (int k = 0; k < n / 2; k++) {
+        double sr = 0, si = 0;
+        for (int i = 0; i < n; i++) {
+            double a = 2 * M_PI * (double)((long)k * i % n) / n;
+            sr += x[i] * cos(a);
+            si -= x[i] * sin(a);
+        }
+        re[k] = sr / n;
+        im[k] = si / n;
+    }
+}
+
+/**
+ * fft_spectrum() in double precision: dBFS per bin. The mean removed is
+ * rounded to a whole code, as the firmware does.
+ */
+static void reference_spectrum(const uint16_t *s, int n, int window, double *dbfs) {
+    static double x[FFT_MAX_POINTS], re[FFT_MAX_POINTS / 2], im[FFT_MAX_POINTS / 2];
+    double mean = 0, gain = 0;
+    for (int i = 0; i < n; i++) mean += s[i];
+    mean = floor(mean / n + 0.5);
+    for (int i = 0; i < n; i++) {
+        double w = 0;
+        for (int k = 0; k < 5; k++) {
+            w += (k & 1 ? -1 : 1) * fft_ref_terms[window][k] * cos(2 * M_PI * k * i / n);
+        }
+        x[i] = (s[i] - mean) * w;
+        gain += w;
+    }
+    reference_dft(x, n, re, im);
+    double full = 16384 * gain / n;
+    for (int k = 0; k < n / 2; k++) {
+        double p = re[k] * re[k] + im[k] * im[k];
+        dbfs[k] = p > 0 ? 10 * log10(p / (full * full)) : -200;
+    }
+}
+
+/**
+ * The transform against a double DFT of the same Q15 input (noise and
+ * tones), in output LSBs (at most 4) and as the rms error's level below
+ * the largest bin. Then the spectrum of tones on and between bins, for every window,
+ * against a double reference: the peak must read within 0.05 dB and
+ * every bin down to 50 dB below it within 1 dB. Last,
+ * the time per spectrum at each size.
+ */
+static void bench_fft(void) {
+    static int16_t x[FFT_MAX_POINTS], re[FFT_MAX_POINTS / 2], im[FFT_MAX_POINTS / 2];
+    static double xd[FFT_MAX_POINTS], rre[FFT_MAX_POINTS / 2], rim[FFT_MAX_POINTS / 2];
+    static uint16_t s[FFT_MAX_POINTS];
+    static int16_t cdb[FFT_MAX_POINTS / 2];
+    static double ref[FFT_MAX_POINTS / 2];
+    int wrong = 0;
+    
+    srand(5);
+    for (int log2n = FFT_MIN_LOG2; log2n <= FFT_MAX_LOG2; log2n++) {
+        int n = 1 << log2n;
+        double worst = 0, floor_db = -200;
+        for (int t = 0; t < FFT_TRIALS; t++) {
+            for (int i = 0; i < n; i++) {
+                double v = t & 1 ? rand() % 65536 - 32768 :
+                           30000 * sin(2 * M_PI * (t * 7.3 + 3) * i / n) + rand() % 2001 - 1000;
+                x[i] = (int16_t)v;
+                xd[i] = x[i];
+            }
+            int exponent = fft_real_q15(x, log2n, re, im);
+            reference_dft(xd, n, rre, rim);
+            double scale = (double)n / (1 << exponent);
+            double err_power = 0, peak = 0;
+            for (int k = 0; k < n / 2; k++) {
+                double er = re[k] - rre[k] * scale, ei = im[k] - rim[k] * scale;
+                double e = sqrt(er * er + ei * ei);
+                double p = (rre[k] * rre[k] + rim[k] * rim[k]) * scale * scale;
+                if (e > worst) worst = e;
+                if (p > peak) peak = p;
+                err_power += er * er + ei * ei;
+            }
+            double db = 10 * log10(err_power / (n / 2) / peak);
+            if (db > floor_db) floor_db = db;
+        }
+        if (worst > 4) wrong++;
+        printf("fft %4d-point transform: worst bin error %.2f LSB, rms error %.1f dB below the largest bin\n",
+               n, worst, -floor_db);
+    }
+    
+    double worst_peak = 0, worst_bin = 0;
+    int compared = 0;
+    for (int log2n = FFT_MIN_LOG2; log2n <= FFT_MAX_LOG2; log2n++) {
+        int n = 1 << log2n;
+        for (int window = 0; window < FFT_WINDOWS; window++) {
+            for (int t = 0; t < 4; t++) {
+                double bin = 20 + (t & 1) * 0.5 + (t >> 1) * 37.25;
+                double amp = t < 2 ? 32000 : 320;
+                for (int i = 0; i < n; i++) {
+                    s[i] = (uint16_t)lround(32768 + amp * sin(2 * M_PI * bin * i / n + t));
+                }
+                fft_spectrum(s, log2n, window, cdb);
+                reference_spectrum(s, n, window, ref);
+                
+                int top = 0;
+                for (int k = 1; k < n / 2; k++) if (ref[k] > ref[top]) top = k;
+                double d = fabs(cdb[top] / 100.0 - ref[top]);
+                if (d > worst_peak) worst_peak = d;
+                if (d > 0.05) wrong++;
+                for (int k = 0; k < n / 2; k++) {
+                    if (ref[k] < ref[top] - FFT_CHECK_RANGE_DB) continue;
+                    d = fabs(cdb[k] / 100.0 - ref[k]);
+                    if (d > worst_bin) worst_bin = d;
+                    if (d > 1) wrong++;
+                    compared++;
+                }
+            }
+        }
+    }
+    printf("fft spectrum: %s, peaks within %.3f dB of double, %d bins within %d dB of them within %.2f dB\n",
+           wrong == 0 ? "ok" : "FAIL", worst_peak, compared, FFT_CHECK_RANGE_DB, worst_bin);
+    
+    // Narrow pulses from 0 to full scale sit nearly 65535 above their
+    // mean: clipped before the window they would grow false harmonics
+    int pulse_wrong = 0;
+    double pulse_worst = 0;
+    compared = 0;
+    for (int log2n = FFT_MIN_LOG2; log2n <= FFT_MAX_LOG2; log2n++) {
+        int n = 1 << log2n;
+        for (int window = 0; window < FFT_WINDOWS; window++) {
+            for (int i = 0; i < n; i++) s[i] = i % 61 < 4 ? 65535 : 0;
+            fft_spectrum(s, log2n, window, cdb);
+            reference_spectrum(s, n, window, ref);
+            int top = 0;
+            for (int k = 1; k < n / 2; k++) if (ref[k] > ref[top]) top = k;
+            for (int k = 0; k < n / 2; k++) {
+                if (ref[k] < ref[top] - FFT_CHECK_RANGE_DB) continue;
+                double d = fabs(cdb[k] / 100.0 - ref[k]);
+                if (d > pulse_worst) pulse_worst = d;
+                if (d > 1) pulse_wrong++;
+                compared++;
+            }
+        }
+    }
+    printf("fft spectrum: %s, full-scale pulse train, %d bins within %d dB of the peak within %.2f dB of double\n",
+           pulse_wrong == 0 ? "ok" : "FAIL", compared, FFT_CHECK_RANGE_DB, pulse_worst);
+    
+    // A tone halfway between bins: only the flat-top reads its true level
+    for (int window = 0; window < FFT_WINDOWS; window++) {
+        int n = FFT_MAX_POINTS;
+        for (int i = 0; i < n; i++) s[i] = (uint16_t)lround(32768 + 32000 * sin(2 * M_PI * 100.5 * i / n));
+        fft_spectrum(s, FFT_MAX_LOG2, window, cdb);
+        int peak = FFT_CDB_ZERO;
+        for (int k = 0; k < n / 2; k++) if (cdb[k] > peak) peak = cdb[k];
+        printf("fft %s: tone at %.2f dBFS between bins reads %.2f dBFS\n",
+               fft_window_name(window), 20 * log10(32000 / 32768.0), peak / 100.0);
+    }
+    
+    printf("fft spectrum time (host):");
+    for (int log2n = FFT_MIN_LOG2; log2n <= FFT_MAX_LOG2; log2n++) {
+        const int rounds = 2000;
+        double t0 = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            fft_spectrum(s, log2n, FFT_WINDOW_HANN, cdb);
+            bench_sink += cdb[r & 127];
+        }
+        double t1 = now_ns();
+        printf(" %d: %.1f us", 1 << log2n, (t1 - t0) / rounds / 1000);
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// Filter stage
+// ============================================================================
+
+#define FILTER_TONE_AMP     8000    // Codes
+#define FILTER_SETTLE       2000    // Input samples before measuring
+#define FILTER_MEASURE      4000    // Input samples measured, whole periods of any integer Hz
+#define FILTER_FLOOR_DB     (-40)   // Gains below this only have to stay below it
+
+static const int filter_tones_hz[] = { 1, 5, 20, 40, 50, 60, 100, 150, 180, 240 };
+#define FILTER_TONES (int)(sizeof filter_tones_hz / sizeof filter_tones_hz[0])
+
+/**
+ * |H| at hz of the filter's quantised coefficients, in dB
+ */
+static double filter_response_db(const filter_t *f, double hz) {
+    double w = 2 * M_PI * hz / FILTER_RATE_HZ;
+    double gain = 1;
+    for (int s = 0; s < f->sections; s++) {
+        const biquad_coefs_t *c = &f->coefs[s];
+        double k = 1.0 / (1 << FILTER_COEF_SHIFT);
+        double nr = c->b0 * k + c->b1 * k * cos(w) + c->b2 * k * cos(2 * w);
+        double ni = -c->b1 * k * sin(w) - c->b2 * k * sin(2 * w);
+        double dr = 1 + c->a1 * k * cos(w) + c->a2 * k * cos(2 * w);
+        double di = -c->a1 * k * sin(w) - c->a2 * k * sin(2 * w);
+        gain *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+    }
+    if (f->taps) {
+        int mid = FILTER_FIR_TAPS / 2;
+        double sum = f->taps[mid];
+        for (int k = 0; k < mid; k++) sum += 2 * f->taps[k] * cos(w * (mid - k));
+        gain = fabs(sum) / 32768;
+    }
+    return 20 * log10(gain);
+}
+
+/**
+ * Run n samples through f in batches like the main loop; returns the
+ * number of outputs
+ */
+static int filter_run(filter_t *f, const uint16_t *in, uint16_t *out, int n) {
+    int m = 0;
+    for (int i = 0; i < n; i += 32) {
+        m += filter_process(f, in + i, out + m, n - i < 32 ? n - i : 32);
+    }
+    return m;
+}
+
+/**
+ * Every filter type against the response of its own quantised
+ * coefficients: the gain measured on tones (rms over whole periods)
+ * must be within 0.1 dB of it, or below FILTER_FLOOR_DB where it is.
+ * A constant input has to come out unchanged (the high-pass: at
+ * mid-scale) to the code. Then the time per input sample.
+ */
+static void bench_filter(void) {
+    static uint16_t in[FILTER_SETTLE + FILTER_MEASURE], out[FILTER_SETTLE + FILTER_MEASURE];
+    const int n = FILTER_SETTLE + FILTER_MEASURE;
+    filter_t f;
+    int wrong = 0;
+
+    for (int type = FILTER_NONE + 1; type < FILTER_COUNT; type++) {
+        double worst = 0;
+        printf("filter %-3s:", filter_name(type));
+        for (int t = 0; t < FILTER_TONES; t++) {
+            int hz = filter_tones_hz[t];
+            for (int i = 0; i < n; i++) {
+                in[i] = (uint16_t)lround(32768 + FILTER_TONE_AMP * sin(2 * M_PI * hz * i / FILTER_RATE_HZ));
+            }
+            filter_init(&f, type);
+            int m = filter_run(&f, in, out, n);
+            double mean = 0, power = 0;
+            int first = FILTER_SETTLE / f.decimation;
+            for (int i = first; i < m; i++) mean += out[i];
+            mean /= m - first;
+            for (int i = first; i < m; i++) power += (out[i] - mean) * (out[i] - mean);
+            double db = 10 * log10(power / (m - first) / (FILTER_TONE_AMP * FILTER_TONE_AMP / 2.0));
+            double expect = filter_response_db(&f, hz);
+            if (expect > FILTER_FLOOR_DB) {
+                if (fabs(db - expect) > worst) worst = fabs(db - expect);
+                if (fabs(db - expect) > 0.1) wrong++;
+            } else if (db > FILTER_FLOOR_DB) {
+                wrong++;
+            }
+            printf(" %d Hz %.1f", hz, db);
+        }
+
+        filter_init(&f, type);
+        for (int i = 0; i < n; i++) in[i] = 50000;
+        int m = filter_run(&f, in, out, n);
+        int want = type == FILTER_HIGHPASS ? 32768 : 50000;
+        int dc_error = abs(out[m - 1] - want);
+        if (dc_error > 1) wrong++;
+
+        const int rounds = 200;
+        for (int i = 0; i < n; i++) in[i] = (uint16_t)(rand() & 0xFFFF);
+        double t0 = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            bench_sink += filter_run(&f, in, out, n);
+        }
+        double t1 = now_ns();
+        printf(" dB; within %.3f dB, DC off by %d; %.1f ns/sample (host)\n",
+               worst, dc_error, (t1 - t0) / rounds / n);
+    }
+    printf("filter response: %s\n", wrong == 0 ? "ok" : "FAIL");
+}
+
+// ============================================================================
+// Math trace
+// ============================================================================
+
+#define MATH_SAMPLES    (1 << 16)
+#define MATH_DERIV_SATURATED_PERMILLE 10    // Only the glitch samples
+
+/**
+ * math_feed() against the same functions in 64-bit arithmetic, clamped
+ * only at the end, on inputs that swing rail to rail. The sum, difference
+ * and integral must never saturate on them, the derivative only around
+ * the glitches. Then the mean and RMS about the math zero against
+ * double, allowing 2 uV, and the time per sample.
+ */
+static void bench_math(void) {
+    static uint16_t a[MATH_SAMPLES], b[MATH_SAMPLES], out[MATH_SAMPLES];
+    int wrong = 0, worst_uv = 0;
+
+    srand(6);
+    for (int i = 0; i < MATH_SAMPLES; i++) {
+        int va = 32768 + (int)(40000 * sin(i * 0.003)) + rand() % 4001 - 2000;
+        int vb = 32768 + (int)(30000 * sin(i * 0.011 + 1)) + rand() % 4001 - 2000;
+        if (i % 2311 < 2) va = rand() & 0xFFFF;
+        a[i] = (uint16_t)(va < 0 ? 0 : va > 65535 ? 65535 : va);
+        b[i] = (uint16_t)(vb < 0 ? 0 : vb > 65535 ? 65535 : vb);
+    }
+
+    printf("math:");
+    for (int f = MATH_NONE + 1; f < MATH_COUNT; f++) {
+        int64_t integral = 0, last = 0;
+        int saturated = 0;
+        math_set(f);
+        for (int i = 0; i < MATH_SAMPLES; i++) {
+            int64_t x = a[i] - 32768, y = b[i] - 32768, v = 0;
+            if (f == MATH_DIFF) v = (x - y) >> MATH_SUM_SHIFT;
+            if (f == MATH_SUM) v = (x + y) >> MATH_SUM_SHIFT;
+            if (f == MATH_DERIV) v = i > 0 ? (x - last) * (1 << MATH_DERIV_SHIFT) : 0;
+            if (f == MATH_INTEGRAL) {
+                integral += x - (integral >> MATH_LEAK_SHIFT);
+                v = integral >> MATH_INTEGRAL_SHIFT;
+            }
+            last = x;
+            v += MATH_ZERO;
+            if (v < 0 || v > 65535) saturated++;
+            uint16_t want = (uint16_t)(v < 0 ? 0 : v > 65535 ? 65535 : v);
+            out[i] = math_feed(a[i], b[i]);
+            if (out[i] != want && wrong++ == 0) {
+                printf(" %s differs at sample %d:", math_name(f), i);
+            }
+        }
+
+        // Statistics about the zero, over the whole stream
+        stats_sums_t sums;
+        stats_sums_reset(&sums);
+        double sum = 0, sumsq = 0, uv = VREF_MV * 1000.0 / 65535;
+        for (int i = 0; i < MATH_SAMPLES; i++) {
+            stats_sums_feed(&sums, out[i], i);
+            double d = (double)out[i] - MATH_ZERO;
+            sum += d;
+            sumsq += d * d;
+        }
+        double err[2] = {
+            stats_value_about(&sums, STATS_MEAN, MATH_ZERO) - sum / MATH_SAMPLES * uv,
+            stats_value_about(&sums, STATS_RMS, MATH_ZERO) - sqrt(sumsq / MATH_SAMPLES) * uv,
+        };
+        for (int k = 0; k < 2; k++) {
+            int e = (int)fabs(err[k]) + 1;
+            if (e > worst_uv) worst_uv = e;
+            if (fabs(err[k]) > 2) wrong++;
+        }
+
+        int bound = f == MATH_DERIV ? MATH_SAMPLES * MATH_DERIV_SATURATED_PERMILLE / 1000 : 0;
+        if (saturated > bound && wrong++ == 0) {
+            printf(" %s saturates on %d samples:", math_name(f), saturated);
+        }
+
+        const int rounds = 50;
+        double t0 = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < MATH_SAMPLES; i++) bench_sink += math_feed(a[i], b[i]);
+        }
+        double t1 = now_ns();
+        printf(" %s %.1f%% saturated, %.1f ns;", math_name(f), 100.0 * saturated / MATH_SAMPLES,
+               (t1 - t0) / rounds / MATH_SAMPLES);
+    }
+    math_set(MATH_NONE);
+    printf(" per sample (host)\nmath: %s, saturation within bounds, mean and RMS about zero "
+           "within %d uV of double\n", wrong == 0 ? "ok" : "FAIL", worst_uv);
+}
+
+// ============================================================================
+// XY display
+// ============================================================================
+
+#define XY_POINTS       20000
+
+/**
+ * Copy the waveform area as shown, flushing the shadow first
+ */
+static void grab_waveform_area(uint8_t *area) {
+    int top, bottom, left, right;
+    vga_get_waveform_bounds(&top, &bottom, &left, &right);
+    vga_flush();
+    for (int y = top; y <= bottom; y++) {
+        for (int x = left; x <= right; x++) *area++ = sim_vga_pixel(x, y);
+    }
+}
+
+/**
+ * Draw a noisy 2:3 Lissajous figure point by point at every trail
+ * length, with and without persistence. No point may cost more than
+ * three pixel writes, and the screen left must match the points held
+ * painted over a clean graticule. Then the cost per point against
+ * redrawing the whole area each time.
+ */
+static void bench_xy(void) {
+    static uint16_t a[XY_POINTS], b[XY_POINTS];
+    static uint8_t drawn[VGA_WAVEFORM_WIDTH * VGA_WAVEFORM_HEIGHT];
+    static uint8_t redrawn[VGA_WAVEFORM_WIDTH * VGA_WAVEFORM_HEIGHT];
+    int left, right, wrong = 0, worst = 0;
+
+    srand(7);
+    for (int i = 0; i < XY_POINTS; i++) {
+        a[i] = (uint16_t)(32768 + 9000 * sin(i * 0.02) + rand() % 201 - 100);
+        b[i] = (uint16_t)(32768 + 7000 * sin(i * 0.03 + 0.5) + rand() % 201 - 100);
+    }
+    vga_get_waveform_bounds(0, 0, &left, &right);
+    vga_set_render_mode(VGA_MODE_INCREMENTAL);
+
+    for (int p = 0; p < 2; p++) {
+        for (int trail = XY_TRAIL_MIN; trail <= XY_RING; trail *= 2) {
+            // Persistence keeps every point on screen, so stay within the ring
+            int points = p ? XY_RING : XY_POINTS;
+            vga_clear_screen(COLOR_BLACK);
+            vga_draw_grid();
+            xy_reset(trail, p);
+            for (int i = 0; i < points; i++) {
+                uint32_t before = xy_pixel_writes();
+                xy_add(a[i], b[i]);
+                int w = (int)(xy_pixel_writes() - before);
+                if (w > worst) worst = w;
+            }
+            grab_waveform_area(drawn);
+            for (int x = left; x <= right; x++) vga_erase_column(x);
+            xy_draw();
+            grab_waveform_area(redrawn);
+            if (memcmp(drawn, redrawn, sizeof drawn) && wrong++ == 0) {
+                printf("xy: trail %d%s differs from a redraw\n", trail, p ? " persistent" : "");
+            }
+        }
+    }
+    printf("xy: %s, at most %d pixel writes per point, %d of 8 screens differ from a redraw\n",
+           wrong == 0 && worst <= 3 ? "ok" : "FAIL", worst, wrong);
+
+    const int redraws = 200;
+    xy_reset(XY_RING, false);
+    double t0 = now_ns();
+    for (int i = 0; i < XY_POINTS; i++) xy_add(a[i], b[i]);
+    double t1 = now_ns();
+    for (int r = 0; r < redraws; r++) {
+        for (int x = left; x <= right; x++) vga_erase_column(x);
+        xy_draw();
+    }
+    double t2 = now_ns();
+    vga_flush();
+    printf("xy: %.1f ns per point drawn, %.1f us to redraw a %d-point trail (host)\n",
+           (t1 - t0) / XY_POINTS, (t2 - t1) / redraws / 1000, XY_RING);
+    vga_clear_screen(COLOR_BLACK);
+}
+
+void sim_bench_run(void) {
+    bench_fixed_readout();
+    bench_trigger();
+    bench_freqmeter();
+    bench_capture_view();
+    bench_recorder_codec();
+    bench_phosphor();
+    bench_sweep();
+    bench_stats();
+    bench_fft();
+    bench_filter();
+    bench_math();
+    bench_xy();
+}
@@ -0,0 +1,33 @@
+/**
+ * sim_lib.c - Host stand-ins for the assembly helpers
+ *
+ * timetemplate.S and boot.S only make sense on the RISC-V core. Here
+ * display_string goes to the simulated JTAG UART and enable_interrupt
+ * turns on interrupt delivery in the simulation.
+ */
+
+#include "sim.h"
+#include "lib.h"
+#include "delay.h"
+#include "dtekv-lib.h"
+
+// ============================================================================
+// timetemplate.S
+// ============================================================================
+
+void display_string(char *s) {
+    print(s);
+    printc('\n');
+}
+
+void delay(int ms) {
+    if (ms > 0) delay_ms(ms);
+}
+
+// ============================================================================
+// boot.S
+// ============================================================================
+
+void enable_interrupt(void) {
+    sim_irq_enable();
+}
@@ -0,0 +1,112 @@
+/**
+ * sim_main.c - Entry point of the host simulation
+ *
+ * Parses the command line, then runs the unmodified firmware main()
+ * (renamed firmware_main by the host Makefile). The firmware never
+ * returns; the run ends when the virtual time limit is reached and the
+ * report below is printed from atexit.
+ *
+ * Usage: fingerscope-sim [options]
+ *   -t ms      virtual run time in milliseconds (default 2000, 0 = forever)
+ *   -o file    write the final framebuffer as a PPM image
+ *   -1 spec    AIN1 source (default sine:5:1.0:1.65), see sim_signal.c
+ *   -2 spec    AIN2 source (default triangle:3:0.8:1.65)
+ *   -s mask    toggle switch value
+ *   -b mask    push button value
+ *   -i ms:sw:btn  from ms on, switches sw and buttons btn (repeatable,
+ *              in time order)
+ *   -q         suppress JTAG UART output
+ *   -B         run the benchmarks in sim_bench.c instead of the firmware
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim.h"
+
+int firmware_main(void);
+
+sim_config_t sim_config = {
+    .run_cycles = 2ULL * SIM_CLOCK_HZ,
+    .ppm_path = NULL,
+    .signal = {
+        { .shape = SIGNAL_SINE, .freq = 5.0, .amplitude = 1.0, .offset = 1.65 },
+        { .shape = SIGNAL_TRIANGLE, .freq = 3.0, .amplitude = 0.8, .offset = 1.65 },
+    },
+    .vref = 3.3,
+    .switches = 0,
+    .buttons = 0,
+    .quiet = false
+};
+
+static struct timespec host_start;
+
+static double host_elapsed(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec - host_start.tv_sec) + (t.tv_nsec - host_start.tv_nsec) * 1e-9;
+}
+
+static void report(void) {
+    fflush(stdout);
+    fprintf(stderr, "\nsim: %.3f s virtual (%llu cycles) in %.3f s host\n",
+            sim_seconds(sim_now()), (unsigned long long)sim_now(), host_elapsed());
+    sim_ad7705_report();
+    sim_vga_report();
+
+    if (sim_config.ppm_path) {
+        if (sim_vga_write_ppm(sim_config.ppm_path) == 0) {
+            fprintf(stderr, "sim: framebuffer written to %s\n", sim_config.ppm_path);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t ms] [-o file.ppm] [-1 spec] [-2 spec] "
+                    "[-s mask] [-b mask] [-i ms:sw:btn] [-q] [-B]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:1:2:s:b:i:qB")) != -1) {
+        switch (opt) {
+        case 't': sim_config.run_cycles = strtoull(optarg, NULL, 0) * (SIM_CLOCK_HZ / 1000); break;
+        case 'o': sim_config.ppm_path = optarg; break;
+        case '1':
+        case '2':
+            if (sim_signal_parse(&sim_config.signal[opt - '1'], optarg) != 0) {
+                fprintf(stderr, "bad signal spec: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 's': sim_config.switches = strtoul(optarg, NULL, 0); break;
+        case 'b': sim_config.buttons = strtoul(optarg, NULL, 0); break;
+        case 'i': {
+            unsigned long long ms;
+            unsigned sw, btn;
+            if (sim_config.event_count == SIM_MAX_INPUT_EVENTS ||
+                sscanf(optarg, "%llu:%i:%i", &ms, &sw, &btn) != 3) {
+                fprintf(stderr, "bad input event: %s\n", optarg);
+                return 2;
+            }
+            sim_input_event_t *e = &sim_config.events[sim_config.event_count++];
+            e->at = ms * (SIM_CLOCK_HZ / 1000);
+            e->switches = sw;
+            e->buttons = btn;
+            break;
+        }
+        case 'q': sim_config.quiet = true; break;
+        case 'B':
+            sim_bench_run();
+            return 0;
+        default:  usage(argv[0]);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &host_start);
+    atexit(report);
+
+    return firmware_main();
+}
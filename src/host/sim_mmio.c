@@ -0,0 +1,116 @@
+/**
+ * sim_mmio.c - Address decoder for the host build
+ *
+ * Implements hal_read32()/hal_write32() by routing each access to the
+ * matching simulated peripheral. Every access costs SIM_MMIO_CYCLES of
+ * virtual time, so polling loops make progress just like on the board.
+ */
+
+#include <stdio.h>
+#include "sim.h"
+#include "hal.h"
+#include "hardware.h"
+#include "vga_driver.h"
+
+#define JTAG_UART_ADDR      0x04000040
+#define JTAG_CTRL_ADDR      0x04000044
+
+static uint32_t gpio_latch;
+static uint32_t gpio_direction;
+static uint32_t leds;
+static uint32_t sev_seg[6];
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+uint32_t sim_gpio_read(void) {
+    // Output pins read back the latch, input pins come from the ADC
+    return (gpio_latch & gpio_direction) | (sim_ad7705_outputs() & ~gpio_direction);
+}
+
+void sim_gpio_write(uint32_t value) {
+    gpio_latch = value;
+    sim_ad7705_pins(gpio_latch & gpio_direction);
+}
+
+uint32_t sim_gpio_direction_read(void) {
+    return gpio_direction;
+}
+
+void sim_gpio_direction_write(uint32_t value) {
+    gpio_direction = value;
+    sim_ad7705_pins(gpio_latch & gpio_direction);
+}
+
+// ============================================================================
+// Address Decoder
+// ============================================================================
+
+/**
+ * Apply the scripted input events that are due
+ */
+static void apply_input_events(void) {
+    static int next;
+    while (next < sim_config.event_count && sim_config.events[next].at <= sim_now()) {
+        sim_config.switches = sim_config.events[next].switches;
+        sim_config.buttons = sim_config.events[next].buttons;
+        next++;
+    }
+}
+
+uint32_t hal_read32(uint32_t addr) {
+    sim_advance(SIM_MMIO_CYCLES);
+
+    if (addr == GPIO_DATA) return sim_gpio_read();
+    if (addr == GPIO_DIRECTION) return sim_gpio_direction_read();
+    if (addr >= TIMER_BASE_ADDR && addr < TIMER_BASE_ADDR + 0x20) {
+        return sim_timer_read(addr - TIMER_BASE_ADDR);
+    }
+    if (addr >= VGA_DMA_BASE && addr < VGA_DMA_BASE + 0x10) {
+        return sim_vga_dma_read(addr - VGA_DMA_BASE);
+    }
+    if (addr == JTAG_CTRL_ADDR) return 0xFFFF0000;  // Always room in the FIFO
+    if (addr == SWITCH_BASE_ADDR || addr == PUSH_BUTTON_BASE_ADDR) {
+        apply_input_events();
+        return addr == SWITCH_BASE_ADDR ? sim_config.switches : sim_config.buttons;
+    }
+    if (addr == LED_BASE_ADDR) return leds;
+
+    fprintf(stderr, "sim: read from unmapped address 0x%08x\n", addr);
+    return 0;
+}
+
+void hal_write32(uint32_t addr, uint32_t value) {
+    sim_advance(SIM_MMIO_CYCLES);
+
+    if (addr == GPIO_DATA) {
+        sim_gpio_write(value);
+    } else if (addr == GPIO_DIRECTION) {
+        sim_gpio_direction_write(value);
+    } else if (addr >= TIMER_BASE_ADDR && addr < TIMER_BASE_ADDR + 0x20) {
+        sim_timer_write(addr - TIMER_BASE_ADDR, value);
+    } else if (addr >= VGA_PIXEL_BUFFER_BASE && addr < VGA_PIXEL_BUFFER_BASE + 2 * VGA_FRAME_BYTES) {
+        sim_vga_mem_write(addr - VGA_PIXEL_BUFFER_BASE, value, 4);
+    } else if (addr >= VGA_DMA_BASE && addr < VGA_DMA_BASE + 0x10) {
+        sim_vga_dma_write(addr - VGA_DMA_BASE, value);
+    } else if (addr == JTAG_UART_ADDR) {
+        if (!sim_config.quiet) putchar(value & 0xFF);
+    } else if (addr == LED_BASE_ADDR) {
+        leds = value;
+    } else if (addr >= SEV_SEG_DISPLAY_BASE_ADDR && addr < SEV_SEG_DISPLAY_BASE_ADDR + 6 * 0x10) {
+        sev_seg[(addr - SEV_SEG_DISPLAY_BASE_ADDR) / 0x10] = value;
+    } else {
+        fprintf(stderr, "sim: write 0x%08x to unmapped address 0x%08x\n", value, addr);
+    }
+}
+
+void hal_write16(uint32_t addr, uint16_t value) {
+    sim_advance(SIM_MMIO_CYCLES);
+
+    if (addr >= VGA_PIXEL_BUFFER_BASE && addr < VGA_PIXEL_BUFFER_BASE + 2 * VGA_FRAME_BYTES) {
+        sim_vga_mem_write(addr - VGA_PIXEL_BUFFER_BASE, value, 2);
+    } else {
+        fprintf(stderr, "sim: 16-bit write 0x%04x to unmapped address 0x%08x\n", value, addr);
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * sim_signal.c - Analog input sources for the simulated AD7705
+ *
+ * A source is described on the command line as
+ *   shape:freq:amplitude:offset[:noise]    (sine, square, triangle, saw, dc)
+ *   file:path:rate[:noise]                 (one voltage per line, looped)
+ * Voltages are in volts, frequencies and rates in Hz. Noise is uniform
+ * with the given peak amplitude and is derived from the sample time, so
+ * runs are exactly repeatable.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+static double noise(uint64_t t) {
+    // splitmix64 of the timestamp, mapped to [-1, 1)
+    uint64_t z = t + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+static int load_file(sim_signal_t *sig, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    size_t capacity = 1024;
+    sig->samples = malloc(capacity * sizeof(double));
+    sig->count = 0;
+
+    double v;
+    while (fscanf(f, "%lf", &v) == 1) {
+        if (sig->count == capacity) {
+            capacity *= 2;
+            sig->samples = realloc(sig->samples, capacity * sizeof(double));
+        }
+        sig->samples[sig->count++] = v;
+    }
+    fclose(f);
+
+    if (sig->count == 0) {
+        fprintf(stderr, "%s: no samples\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int sim_signal_parse(sim_signal_t *sig, const char *spec) {
+    char buf[256];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    char *fields[5] = { 0 };
+    int n = 0;
+    for (char *tok = strtok(buf, ":"); tok && n < 5; tok = strtok(NULL, ":")) {
+        fields[n++] = tok;
+    }
+    if (n == 0) return -1;
+
+    memset(sig, 0, sizeof(*sig));
+
+    if (strcmp(fields[0], "file") == 0) {
+        if (n < 3) return -1;
+        sig->shape = SIGNAL_FILE;
+        sig->freq = atof(fields[2]);
+        if (n > 3) sig->noise = atof(fields[3]);
+        return load_file(sig, fields[1]);
+    }
+
+    static const char *names[] = { "sine", "square", "triangle", "saw", "dc" };
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(fields[0], names[i]) == 0) {
+            sig->shape = (sim_shape_t)i;
+            if (n > 1) sig->freq = atof(fields[1]);
+            if (n > 2) sig->amplitude = atof(fields[2]);
+            if (n > 3) sig->offset = atof(fields[3]);
+            if (n > 4) sig->noise = atof(fields[4]);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+double sim_signal_voltage(const sim_signal_t *sig, uint64_t t) {
+    double seconds = sim_seconds(t);
+    double phase = sig->freq * seconds;
+    phase -= floor(phase);
+    double v;
+
+    switch (sig->shape) {
+    case SIGNAL_SINE:     v = sin(2.0 * M_PI * phase); break;
+    case SIGNAL_SQUARE:   v = phase < 0.5 ? 1.0 : -1.0; break;
+    case SIGNAL_TRIANGLE: v = phase < 0.5 ? 4.0 * phase - 1.0 : 3.0 - 4.0 * phase; break;
+    case SIGNAL_SAW:      v = 2.0 * phase - 1.0; break;
+    case SIGNAL_FILE: {
+        // Linear interpolation between file samples, looping at the end
+        double pos = fmod(seconds * sig->freq, (double)sig->count);
+        size_t i = (size_t)pos;
+        double frac = pos - i;
+        double a = sig->samples[i];
+        double b = sig->samples[(i + 1) % sig->count];
+        return a + (b - a) * frac + sig->noise * noise(t);
+    }
+    default:              v = 0.0; break;
+    }
+
+    return sig->offset + sig->amplitude * v + sig->noise * noise(t);
+}
@@ -0,0 +1,143 @@
+/**
+ * sim_timer.c - Virtual clock and interval timer for the host build
+ *
+ * The timer is modelled on its register interface: PERIODL/PERIODH hold
+ * the reload value, CTRL starts/stops it and STATUS.TO is set every time
+ * the count passes zero. Timeouts are computed lazily from the virtual
+ * clock whenever a register is accessed.
+ *
+ * Interrupts are taken between simulated I/O accesses: whenever virtual
+ * time advances and the timer has a pending timeout with ITO set, the
+ * firmware handler runs to completion before the access proceeds. As on
+ * the core, the handler itself is not interrupted.
+ */
+
+#include <stdlib.h>
+#include "sim.h"
+#include "hal.h"
+
+static uint64_t now_cycles;
+
+static struct {
+    uint32_t status;
+    uint32_t ctrl;
+    uint32_t period_low;
+    uint32_t period_high;
+    bool running;
+    uint64_t next_timeout;      // Virtual time of the next zero crossing
+} timer;
+
+static bool irq_enabled;
+static bool in_isr;
+
+static void timer_update(void);
+
+uint64_t sim_now(void) {
+    return now_cycles;
+}
+
+/**
+ * Advance the virtual clock. The run ends here once the configured
+ * amount of virtual time has passed; sim_main.c reports from atexit.
+ */
+void sim_advance(uint64_t cycles) {
+    now_cycles += cycles;
+    if (sim_config.run_cycles != 0 && now_cycles >= sim_config.run_cycles) {
+        exit(0);
+    }
+
+    if (irq_enabled && !in_isr) {
+        timer_update();
+        if ((timer.status & TIMER_STATUS_TO) && (timer.ctrl & TIMER_CTRL_ITO)) {
+            in_isr = true;
+            handle_interrupt(TIMER_IRQ);
+            in_isr = false;
+        }
+    }
+}
+
+/**
+ * The cycle counter is the virtual clock. Each read costs one turn of a
+ * polling loop, which is what lets delay_until() make progress.
+ */
+uint32_t hal_read_cycles(void) {
+    sim_advance(SIM_CYCLE_POLL_CYCLES);
+    return (uint32_t)now_cycles;
+}
+
+void sim_irq_enable(void) {
+    irq_enabled = true;
+}
+
+/**
+ * Idle until the next timer interrupt instead of spinning through
+ * millions of empty polls
+ */
+void hal_idle(void) {
+    uint64_t wait = SIM_MMIO_CYCLES;
+    if (irq_enabled && timer.running && (timer.ctrl & TIMER_CTRL_ITO) &&
+        timer.next_timeout > now_cycles) {
+        wait = timer.next_timeout - now_cycles;
+    }
+    sim_advance(wait);
+}
+
+double sim_seconds(uint64_t cycles) {
+    return (double)cycles / SIM_CLOCK_HZ;
+}
+
+static uint64_t timer_period(void) {
+    return ((uint64_t)(timer.period_high & 0xFFFF) << 16 | (timer.period_low & 0xFFFF)) + 1;
+}
+
+static void timer_update(void) {
+    if (!timer.running || now_cycles < timer.next_timeout) {
+        return;
+    }
+
+    timer.status |= TIMER_STATUS_TO;
+    if (timer.ctrl & TIMER_CTRL_CONT) {
+        uint64_t period = timer_period();
+        uint64_t missed = (now_cycles - timer.next_timeout) / period;
+        timer.next_timeout += (missed + 1) * period;
+    } else {
+        timer.running = false;
+    }
+}
+
+uint32_t sim_timer_read(uint32_t offset) {
+    timer_update();
+    switch (offset) {
+    case 0x0: return timer.status | (timer.running ? 0x2 : 0);  // RUN bit
+    case 0x4: return timer.ctrl;
+    case 0x8: return timer.period_low;
+    case 0xC: return timer.period_high;
+    default:  return 0;
+    }
+}
+
+void sim_timer_write(uint32_t offset, uint32_t value) {
+    timer_update();
+    switch (offset) {
+    case 0x0:
+        // Any write clears the timeout flag
+        timer.status &= ~TIMER_STATUS_TO;
+        break;
+    case 0x4:
+        timer.ctrl = value & (TIMER_CTRL_ITO | TIMER_CTRL_CONT);
+        if (value & TIMER_CTRL_STOP) {
+            timer.running = false;
+        }
+        if (value & TIMER_CTRL_START) {
+            timer.running = true;
+            timer.next_timeout = now_cycles + timer_period();
+        }
+        break;
+    case 0x8:
+        timer.period_low = value & 0xFFFF;
+        break;
+    case 0xC:
+        timer.period_high = value & 0xFFFF;
+        break;
+    }
+}
@@ -0,0 +1,130 @@
+/**
+ * sim_vga.c - VGA pixel buffer and its DMA controller for the host build
+ *
+ * Pixel stores to the two VGA frames arrive through the address decoder
+ * and land in an in-memory array. The DMA controller model has the Buffer and
+ * BackBuffer registers: a write to Buffer requests a swap, which takes
+ * effect at the end of the frame being scanned out (60 Hz) and keeps
+ * the Status S bit set until then.
+ *
+ * The frame on screen can be dumped as a binary PPM image for inspection.
+ */
+
+#include <stdio.h>
+#include "sim.h"
+#include "vga_driver.h"
+
+static uint16_t pixels[2 * SCREEN_WIDTH * SCREEN_HEIGHT];
+
+static struct {
+    uint32_t buffer;            // Frame being scanned out
+    uint32_t back_buffer;
+    bool swap_pending;
+    uint64_t swap_at;           // End of the frame the swap waits for
+    uint32_t swaps;
+    uint64_t swap_wait_total;   // Request to swap, summed over all swaps
+} dma = {
+    .buffer = VGA_PIXEL_BUFFER_BASE,
+    .back_buffer = VGA_PIXEL_BUFFER_BASE,
+};
+
+static uint64_t swap_requested_at;
+
+static void dma_update(void) {
+    if (dma.swap_pending && sim_now() >= dma.swap_at) {
+        uint32_t t = dma.buffer;
+        dma.buffer = dma.back_buffer;
+        dma.back_buffer = t;
+        dma.swap_pending = false;
+        dma.swaps++;
+        dma.swap_wait_total += dma.swap_at - swap_requested_at;
+    }
+}
+
+/**
+ * Store into VGA memory, offset relative to VGA_PIXEL_BUFFER_BASE.
+ * A 32-bit store sets two neighbouring pixels, low half first.
+ */
+void sim_vga_mem_write(uint32_t offset, uint32_t value, int bytes) {
+    uint32_t i = offset / 2;
+    if (i >= sizeof(pixels) / sizeof(pixels[0])) return;
+    pixels[i] = value & 0xFFFF;
+    if (bytes == 4 && i + 1 < sizeof(pixels) / sizeof(pixels[0])) {
+        pixels[i + 1] = value >> 16;
+    }
+}
+
+uint32_t sim_vga_dma_read(uint32_t offset) {
+    dma_update();
+    switch (offset) {
+    case 0x0: return dma.buffer;
+    case 0x4: return dma.back_buffer;
+    case 0x8: return (SCREEN_HEIGHT << 16) | SCREEN_WIDTH;
+    case 0xC:
+        // 2 bytes per pixel, consecutive addressing
+        return (2 << 4) | (1 << 1) | (dma.swap_pending ? VGA_DMA_STATUS_SWAP : 0);
+    default:  return 0;
+    }
+}
+
+void sim_vga_dma_write(uint32_t offset, uint32_t value) {
+    dma_update();
+    switch (offset) {
+    case 0x0:
+        if (!dma.swap_pending) {
+            uint64_t now = sim_now();
+            dma.swap_pending = true;
+            dma.swap_at = (now / SIM_VGA_FRAME_CYCLES + 1) * SIM_VGA_FRAME_CYCLES;
+            swap_requested_at = now;
+        }
+        break;
+    case 0x4:
+        dma.back_buffer = value;
+        break;
+    }
+}
+
+void sim_vga_report(void) {
+    dma_update();
+    if (dma.swaps == 0) return;
+    fprintf(stderr, "vga: %u buffer swaps, average wait for vsync %.2f ms\n",
+            dma.swaps, sim_seconds(dma.swap_wait_total / dma.swaps) * 1e3);
+}
+
+/**
+ * Colour of a pixel of the frame on screen, for checks
+ */
+uint8_t sim_vga_pixel(int x, int y) {
+    dma_update();
+    return pixels[(dma.buffer - VGA_PIXEL_BUFFER_BASE) / 2 + y * SCREEN_WIDTH + x] & 0xFF;
+}
+
+/**
+ * Write the frame on screen as a P6 PPM, expanding RGB332 to 8 bits per
+ * channel
+ */
+int sim_vga_write_ppm(const char *path) {
+    dma_update();
+    const uint16_t *frame = pixels +
+                            (dma.buffer - VGA_PIXEL_BUFFER_BASE) / 2;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        uint8_t c = frame[i] & 0xFF;
+        uint8_t rgb[3] = {
+            (uint8_t)(((c >> 5) & 0x7) * 255 / 7),
+            (uint8_t)(((c >> 2) & 0x7) * 255 / 7),
+            (uint8_t)((c & 0x3) * 255 / 3),
+        };
+        fwrite(rgb, 1, 3, f);
+    }
+
+    fclose(f);
+    return 0;
+}
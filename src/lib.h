@@ -8,5 +8,6 @@ extern void time2string(char*, int);
 extern void tick(int*);
 extern void delay(int);
 extern int nextprime(int);
+extern void enable_interrupt(void);
 
 #endif /* LIB_H */
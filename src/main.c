@@ -4,60 +4,754 @@
  * Features:
  * - Real-time waveform display on VGA (320x240)
  * - Professional HP-style oscilloscope UI
- * - Voltage measurements (current, Vpp, min, max)
- * - Scrolling waveform display
+ * - Voltage measurements (Vpp, mean, RMS, AC RMS, std dev, min/max)
+ * - Edge trigger (auto/normal/single) with pre-trigger capture
+ * - Frequency and duty cycle, timebase from the measured sample rate
+ * - Deep capture with min/max zoom and pan
+ * - Run/Stop on the push button, zoom and pan through the frozen capture
+ * - Compressed recording of the input, replay at up to 8x
+ * - Second channel on AIN2, interleaved with CH1 by the sampler
+ * - Intensity-graded persistence display
+ * - Averaging, envelope and hi-res acquisition modes
+ * - Fixed-point FFT spectrum display
+ * - IIR/FIR filter stage ahead of the trigger and measurements
+ * - Math trace: CH1-CH2, CH1+CH2, derivative, leaky integral
+ * - XY display of CH1 against CH2 with a fading trail or persistence
+ * - Interrupt-driven sampling, decoupled from rendering
  */
 
 #include <stdint.h>
 #include <stdbool.h>
 #include "hardware.h"
+#include "hal.h"
 #include "spi_driver.h"
 #include "ad7705_driver.h"
 #include "vga_driver.h"
+#include "acquisition.h"
+#include "trigger.h"
+#include "freqmeter.h"
+#include "capture.h"
+#include "recorder.h"
+#include "phosphor.h"
+#include "sweep.h"
+#include "stats.h"
+#include "fft.h"
+#include "filter.h"
+#include "math_channel.h"
+#include "xy.h"
+#include "fixed.h"
 #include "timer.h"
 #include "dtekv-lib.h"
 #include "delay.h"
 #include "lib.h"
 
-#define VREF                3.3f    // Reference voltage
-#define VOLTS_PER_DIV       0.5f    // Voltage scale
-#define TIME_PER_DIV_MS     10.0f   // Time scale
+#define MV_PER_DIV          500     // Voltage scale
+#define ACQ_TICK_HZ         1000    // DRDY poll rate, 2x the 500 Hz ADC update rate
+#define ADC_NOMINAL_MHZ     500000  // ADC update rate in mHz until one is measured
+#define MEASURE_INTERVAL    256     // Samples between frequency/timebase updates
+// Conversions per channel between switches. 1 is the most switches, not
+// the fewest, but the only block that keeps each channel's samples evenly
+// spaced, which the capture and display assume: 4 would give 154 S/s per
+// channel at 2-20 ms intervals, 16 would give 216 S/s with 44 ms gaps.
+#define ACQ_DUAL_BLOCK      1
+#define ADC_DUAL_NOMINAL_MHZ (ADC_NOMINAL_MHZ / 7)  // Per channel, as measured: 14 ms apart
 
+#define CYCLES_TO_US(c)     ((uint32_t)((uint64_t)(c) * 1000000 / SYSTEM_CLOCK_FREQ))
+#define RENDER_BATCH        32      // Max samples drawn per pass of the main loop
+// Switch 9 selects setup. Switches 0-8 are setup settings with it on, read
+// at boot only, and run controls with it off; a scope booted with it off
+// takes the default setup.
+#define SW_SETUP            0x200   // Switch 9: setup, the run controls hold
+#define SW_SPECTRUM         0x01    // Switch 0 in setup: spectrum display instead of traces
+#define SW_DUAL_CHANNEL     0x02    // Switch 1 in setup: sample AIN2 as CH2 as well
+#define SW_DOUBLE_BUFFER    0x04    // Switch 2 in setup: compose whole frames off screen
+#define SW_TRIG_FALLING     0x08    // Switch 3 in setup: trigger on the falling edge
+#define SW_TRIG_NORMAL      0x10    // Switch 4 in setup: normal trigger mode (no auto)
+#define SW_TRIG_SINGLE      0x20    // Switch 5 in setup: single shot, Run re-arms
+#define SW_FILTER_SHIFT     6       // Switches 6-8 in setup, single channel: FILTER_* on CH1
+#define SW_FILTER_MASK      0x7
+#define SW_MATH_SHIFT       6       // Switches 6-8 in setup, dual channel: MATH_* trace
+#define SW_MATH_MASK        0x7
+#define SW_MATH_XY          5       // That value instead: XY display
+#define SW_PAN_OLDER        0x01    // Switch 0: scroll the view back in time
+#define SW_PAN_NEWER        0x02    // Switch 1: scroll the view forward
+#define SW_MEASUREMENT      0x04    // Switch 2: each flip steps the footer measurement
+#define SW_ACQUIRE_SHIFT    3       // Switches 3-4 when live: VGA_ACQ_* mode
+#define SW_ACQUIRE_MASK     0x3
+#define SW_SPEED_SHIFT      3       // Switches 3-4 during replay: 2^n times real time
+#define SW_SPEED_MASK       0x3
+#define SW_WINDOW_SHIFT     3       // Switches 3-4 in spectrum mode when live: FFT_WINDOW_*
+#define SW_WINDOW_MASK      0x3
+#define SW_XY_TRAIL_SHIFT   3       // Switches 3-4 in XY mode when live: XY_TRAIL_MIN << n points
+#define SW_XY_TRAIL_MASK    0x3
+#define SW_PERSIST          0x20    // Switch 5: persistence display
+#define SW_REPLAY           0x40    // Switch 6: replay the recording instead of the input
+#define SW_ZOOM_SHIFT       7       // Switches 7-8: zoom out, 4^n samples per column
+#define SW_ZOOM_MASK        0x3
+#define SW_FFT_SIZE_SHIFT   7       // Switches 7-8 in spectrum mode: 256 << n points
+#define SW_FFT_SIZE_MASK    0x3
 
-// Waveform buffer
-static uint16_t waveform_buffer[SCREEN_WIDTH];
+#define PAN_INTERVAL        16      // Samples between pan steps while a pan switch is on
+#define PAN_STEP_COLUMNS    8       // Columns scrolled per step
 
-// Display position
-static int current_x = 0;
+#define SPECTRUM_HOP        128     // Samples between spectra, ~4 per second
+#define SPECTRUM_FLOOR_CDB  (-VGA_SPECTRUM_DB_PER_DIV * VGA_GRID_DIV_Y * 100)  // Bottom of the grid
+
+#define TRIG_LEVEL          32768   // Mid-scale
+#define TRIG_HYSTERESIS     656     // 1% of full scale
+
+
+// Waveform envelope, one min/max pair per screen column
+static uint16_t wave_min[SCREEN_WIDTH];
+static uint16_t wave_max[SCREEN_WIDTH];
+static uint16_t wave2_min[SCREEN_WIDTH];
+static uint16_t wave2_max[SCREEN_WIDTH];
+static uint16_t wave3_min[SCREEN_WIDTH];
+static uint16_t wave3_max[SCREEN_WIDTH];
+
+// Sampling AIN2 as CH2, set at boot. CH2 is held against CH1's sample
+// positions; the trigger, measurements and recording follow CH1.
+static bool dual;
+
+// Math trace, MATH_*, set at boot in dual-channel mode. Its samples are
+// worked out as CH1 and CH2 come in and go into the capture as a third
+// channel, so it zooms, pans and freezes with them.
+static int math = MATH_NONE;
+
+// XY display, set at boot in dual-channel mode: CH1 across, CH2 up, in
+// place of the traces. Points stop while stopped.
+static bool xy_mode;
+static int xy_trail = XY_TRAIL_MIN;
+static uint32_t xy_points;          // Points added since the last report
+static uint32_t xy_writes_mark;     // xy_pixel_writes() at the last report
+
+// View into the deep capture: 2^zoom samples per column, ending pan
+// samples before the end of the latest record
+static int zoom;
+static uint32_t pan;
+static uint32_t view_end;
+
+// Persistence display selected, and on screen. It builds up while
+// running; a view change while stopped shows the plain trace.
+static bool persist;
+static bool phosphor_shown;
+
+// Acquisition mode, VGA_ACQ_*. Averaging and envelope build up over the
+// sweeps shown while running; a view change starts them over.
+static int acquire = VGA_ACQ_NORMAL;
+
+// Spectrum display, set at boot: the waveform area shows the spectrum of
+// the newest 2^fft_log2 samples of the capture on display instead of the
+// trigger record, 0 dBFS at the top
+static bool spectrum;
+static int fft_log2 = FFT_MIN_LOG2;
+static int fft_window = FFT_WINDOW_HANN;
+static uint16_t fft_block[FFT_MAX_POINTS];
+static int16_t fft_levels[FFT_MAX_POINTS / 2];
+static uint32_t fft_cycles;         // Last spectrum, both channels
+
+// Filter stage on CH1, set at boot. Its coefficients are designed for
+// the single-channel rate, so dual mode runs unfiltered. A decimating
+// filter divides the rate everything after it sees.
+static filter_t filter;
+static uint32_t filter_cycles;      // Since the last report
+static uint32_t filter_samples;     // Input samples in filter_cycles
+static uint32_t filter_peak;        // Highest cycles per sample over a batch
+
+// Replaying the recording; otherwise the live input is being recorded
+static bool replaying;
+static uint32_t replay_rate_mhz;
+
+// Run/Stop: while stopped the display shows a frozen copy of the capture
+static bool running = true;
+static uint32_t redraws;            // Redraws of the frozen capture since Stop
+static uint32_t redraw_max;         // Longest, in cycles
+
+// Waveform area bounds
 static int grat_left, grat_right, grat_top, grat_bottom;
 
-// Statistics
-static uint16_t adc_min = 65535;
-static uint16_t adc_max = 0;
+// VGA words flushed when the last report was printed
+static uint32_t vga_words_mark;
+
+// Double-buffered: something changed since the last composed frame
+static bool frame_stale = true;
+
+// Measurements, refreshed every MEASURE_INTERVAL samples
+static uint32_t sample_rate_mhz = ADC_NOMINAL_MHZ;
+static int32_t time_per_div_us;
+static freq_result_t freq;
+static uint32_t freq_mhz;           // 0 = no periodic signal
+
+// Statistics per channel, over the current sweep and over the last
+// STATS_WINDOW samples. The footer shows one measurement of the window.
+static stats_sums_t sweep_stats[3];
+static stats_window_t window_stats[3];
+static uint32_t positions[3];       // Samples fed per channel, the math trace third
+static int measurement = STATS_VPP;
+static const char *const measurement_labels[STATS_COUNT] = {
+    "Pk:", "Avg", "RMS", "AC:", "SD:"
+};
 
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
-static float adc_to_voltage(uint16_t adc_value) {
-    return (float)adc_value * VREF / 65535.0f;
+static void reset_statistics(void) {
+    stats_sums_reset(&sweep_stats[0]);
+    stats_sums_reset(&sweep_stats[1]);
+    stats_sums_reset(&sweep_stats[2]);
 }
 
-static void reset_statistics(void) {
-    adc_min = 65535;
-    adc_max = 0;
+static void update_statistics(int ch, uint16_t adc_value) {
+    stats_sums_feed(&sweep_stats[ch], adc_value, positions[ch]++);
+    stats_window_feed(&window_stats[ch], adc_value);
 }
 
-static void update_statistics(uint16_t adc_value) {
-    if (adc_value < adc_min) adc_min = adc_value;
-    if (adc_value > adc_max) adc_max = adc_value;
+/**
+ * CH2 is shown while sampling it live; the recording holds CH1 only
+ */
+static bool show_ch2(void) {
+    return dual && !replaying;
+}
+
+/**
+ * The math trace needs CH2, so it is shown with it
+ */
+static bool show_math(void) {
+    return math != MATH_NONE && show_ch2();
+}
+
+/**
+ * V/div of the math trace, 0 where it is not a voltage
+ */
+static int32_t math_vdiv_mv(void) {
+    return math == MATH_DIFF || math == MATH_SUM ? MV_PER_DIV << math_shift(math) : 0;
+}
+
+/**
+ * So does the XY display; replay shows CH1's trace instead
+ */
+static bool show_xy(void) {
+    return xy_mode && show_ch2();
+}
+
+/**
+ * Refresh the time/div readout. The record spans the waveform area one
+ * sample per column at zoom 0, so time/div follows from the effective
+ * sample rate measured on the samples' timestamps.
+ */
+static void update_timebase(int record_len) {
+    time_per_div_us = (int32_t)(((uint64_t)record_len << zoom) * 1000000000ULL /
+                                ((uint64_t)VGA_GRID_DIV_X * sample_rate_mhz));
+    vga_scope_set_timebase(time_per_div_us);
+    if (spectrum) {
+        // The bins span 0 to half the sample rate across the grid
+        vga_scope_set_spectrum(1 << fft_log2, fft_window_name(fft_window),
+                               (int32_t)(sample_rate_mhz / (2 * VGA_GRID_DIV_X)));
+    }
+}
+
+/**
+ * Format and show the selected measurement of each channel on display
+ */
+static void show_measurement(void) {
+    stats_sums_t sums;
+    stats_window_sums(&window_stats[0], &sums);
+    vga_scope_set_measurement(1, measurement_labels[measurement], stats_value(&sums, measurement));
+    if (show_ch2()) {
+        stats_window_sums(&window_stats[1], &sums);
+        vga_scope_set_measurement(2, measurement_labels[measurement], stats_value(&sums, measurement));
+    }
+    if (show_math()) {
+        stats_window_sums(&window_stats[2], &sums);
+        vga_scope_set_measurement(3, measurement_labels[measurement],
+                                  stats_value_about(&sums, measurement, MATH_ZERO) *
+                                  (1 << math_shift(math)));
+    }
+}
+
+/**
+ * Refresh the sample rate, the timebase and the frequency and voltage
+ * readouts
+ */
+static void update_measurements(int record_len) {
+    uint32_t rate = replaying ? replay_rate_mhz : acquisition_sample_rate_mhz(CHN_AIN1);
+    if (rate > 0) sample_rate_mhz = rate / filter.decimation;
+    update_timebase(record_len);
+    
+    if (freq_read(&freq)) {
+        freq_mhz = freq_to_millihertz(&freq, sample_rate_mhz);
+        vga_scope_set_frequency_fixed(freq_mhz, freq.duty_permille);
+    } else {
+        freq_mhz = 0;
+        vga_scope_set_frequency_fixed(0, 0);
+    }
+    show_measurement();
 }
 
 // ============================================================================
 // Interrupt Handler
 // ============================================================================
 void handle_interrupt(unsigned cause) {
-    // Timer interrupt if needed
+    if (cause == TIMER_IRQ) {
+        timer_check_tick();     // Acknowledge the timeout
+        acquisition_isr();
+    }
+}
+
+// ============================================================================
+// Rendering
+// ============================================================================
+
+/**
+ * Show the waveform area from wave_min/max (or the phosphor) and
+ * wave2_min/max. In double-buffered mode render_frame() draws it with
+ * the next frame.
+ */
+static void draw_view(void) {
+    if (vga_get_render_mode() == VGA_MODE_DOUBLE_BUFFER) {
+        frame_stale = true;
+        return;
+    }
+    
+    if (show_xy()) {
+        for (int x = grat_left; x <= grat_right; x++) {
+            vga_erase_column(x);
+        }
+        xy_draw();
+        return;
+    }
+    if (phosphor_shown) {
+        phosphor_draw();
+    } else {
+        for (int x = grat_left; x <= grat_right; x++) {
+            vga_erase_column(x);
+        }
+        vga_draw_envelope(wave_min, wave_max, grat_left, grat_right, COLOR_WAVEFORM);
+    }
+    if (show_ch2()) {
+        vga_draw_envelope(wave2_min, wave2_max, grat_left, grat_right, COLOR_WAVEFORM2);
+    }
+    if (show_math()) {
+        vga_draw_envelope(wave3_min, wave3_max, grat_left, grat_right, COLOR_MATH);
+    }
+    if (!spectrum) vga_draw_trigger_marker();
+}
+
+/**
+ * Reduce the current view of the capture to the waveform area and show
+ * it. At zoom 0 with no pan the view is exactly the latest trigger
+ * record. A new sweep (a trigger record) is added to the sweep averages
+ * and the phosphor; with persistence on, the phosphor is shown instead
+ * of CH1.
+ */
+static void show_view(bool sweep) {
+    int columns = grat_right - grat_left + 1;
+    uint32_t span = (uint32_t)columns << zoom;
+    uint32_t end = view_end - pan;
+    
+    // Hi-res and averaging work on column means, the rest on min/max
+    if (acquire == VGA_ACQ_HIRES || acquire == VGA_ACQ_AVERAGE) {
+        capture_view_mean(0, end, span, columns, &wave_min[grat_left], &wave_max[grat_left]);
+    } else {
+        capture_view(0, end, span, columns, &wave_min[grat_left], &wave_max[grat_left]);
+    }
+    if (show_ch2()) {
+        if (acquire == VGA_ACQ_HIRES) {
+            capture_view_mean(1, end, span, columns, &wave2_min[grat_left], &wave2_max[grat_left]);
+        } else {
+            capture_view(1, end, span, columns, &wave2_min[grat_left], &wave2_max[grat_left]);
+        }
+    }
+    if (show_math()) {
+        capture_view(CAPTURE_MATH, end, span, columns, &wave3_min[grat_left], &wave3_max[grat_left]);
+    }
+    
+    if (acquire == VGA_ACQ_AVERAGE) {
+        if (sweep) sweep_add_average(wave_min, wave_max, grat_left, grat_right);
+        if (sweep_count() > 0) sweep_get_average(wave_min, wave_max, grat_left, grat_right);
+    } else if (acquire == VGA_ACQ_ENVELOPE) {
+        if (sweep) sweep_add_envelope(wave_min, wave_max, grat_left, grat_right);
+        if (sweep_count() > 0) sweep_get_envelope(wave_min, wave_max, grat_left, grat_right);
+    }
+    
+    phosphor_shown = persist && running;
+    if (phosphor_shown && sweep) {
+        phosphor_add_envelope(wave_min, wave_max, grat_left, grat_right);
+    }
+    draw_view();
+}
+
+/**
+ * Spectrum level in centi-dB to the ADC scale the traces are drawn in
+ */
+static uint16_t level_to_code(int32_t cdb) {
+    int32_t level = cdb - SPECTRUM_FLOOR_CDB;
+    if (level <= 0) return 0;
+    if (level >= -SPECTRUM_FLOOR_CDB) return 65535;
+    return (uint16_t)((uint32_t)level * 65535 / -SPECTRUM_FLOOR_CDB);
+}
+
+/**
+ * Spectrum of the newest 2^fft_log2 samples of each channel shown, one
+ * min/max pair of levels per column like a trace: a column spanning
+ * several bins keeps their lowest and highest level, so a line narrower
+ * than a column still shows, and a bin wider than a column spreads
+ * over several. Nothing is drawn until the capture holds a whole block.
+ * The phosphor, when on, collects the spectra as it does sweeps.
+ */
+static void show_spectrum(void) {
+    int columns = grat_right - grat_left + 1;
+    int bins = 1 << (fft_log2 - 1);
+    uint32_t t0 = hal_read_cycles();
+    
+    for (int ch = 0; ch < (show_ch2() ? 2 : 1); ch++) {
+        uint16_t *mins = (ch == 0 ? wave_min : wave2_min) + grat_left;
+        uint16_t *maxs = (ch == 0 ? wave_max : wave2_max) + grat_left;
+        bool whole = capture_read(ch, capture_count(), 1 << fft_log2, fft_block) > 0;
+        if (whole) fft_spectrum(fft_block, fft_log2, fft_window, fft_levels);
+        
+        for (int c = 0; c < columns; c++) {
+            int a = c * bins / columns;
+            int b = (c + 1) * bins / columns;
+            if (b <= a) b = a + 1;
+            uint16_t lo = 0xFFFF, hi = 0;
+            for (int k = a; whole && k < b; k++) {
+                uint16_t code = level_to_code(fft_levels[k]);
+                if (code < lo) lo = code;
+                if (code > hi) hi = code;
+            }
+            mins[c] = lo;
+            maxs[c] = hi;
+        }
+    }
+    fft_cycles = hal_read_cycles() - t0;
+    
+    phosphor_shown = persist && running;
+    if (phosphor_shown) {
+        phosphor_decay(PHOSPHOR_DECAY_SHIFT);
+        phosphor_add_envelope(wave_min, wave_max, grat_left, grat_right);
+    }
+    draw_view();
+}
+
+/**
+ * Redraw the waveform area after a change of source, mode or state
+ */
+static void refresh_view(void) {
+    if (spectrum) show_spectrum();
+    else if (show_xy()) draw_view();
+    else show_view(false);
+}
+
+/**
+ * Start the XY display over with the current trail and persistence
+ */
+static void reset_xy(void) {
+    xy_reset(xy_trail, persist);
+    vga_scope_set_xy(show_xy(), persist ? 0 : xy_trail);
+}
+
+/**
+ * In XY mode the acquisition mode switches pick the trail length while
+ * live
+ */
+static void update_xy_view(int sw) {
+    int trail = XY_TRAIL_MIN << ((sw >> SW_XY_TRAIL_SHIFT) & SW_XY_TRAIL_MASK);
+    if (trail == xy_trail) return;
+    xy_trail = trail;
+    reset_xy();
+    draw_view();
+}
+
+/**
+ * In spectrum mode the zoom switches pick the FFT size and, while live,
+ * the acquisition mode switches pick the window
+ */
+static void update_spectrum_view(int sw, int record_len) {
+    int size = (sw >> SW_FFT_SIZE_SHIFT) & SW_FFT_SIZE_MASK;
+    int new_log2 = FFT_MIN_LOG2 + size;
+    int new_window = replaying ? fft_window : (sw >> SW_WINDOW_SHIFT) & SW_WINDOW_MASK;
+    if (new_log2 > FFT_MAX_LOG2) new_log2 = FFT_MAX_LOG2;
+    
+    if (new_log2 == fft_log2 && new_window == fft_window) return;
+    fft_log2 = new_log2;
+    fft_window = new_window;
+    update_timebase(record_len);
+    phosphor_clear();
+    show_spectrum();
+}
+
+/**
+ * Apply the zoom and pan switches, redraw if the view moved. Pan is
+ * limited to the samples the capture on display still holds.
+ */
+static void update_view(int sw, int samples, int record_len) {
+    static int pan_wait;
+    int new_zoom = 2 * ((sw >> SW_ZOOM_SHIFT) & SW_ZOOM_MASK);
+    uint32_t span = (uint32_t)record_len << new_zoom;
+    uint32_t held = view_end - capture_oldest();
+    uint32_t step = (uint32_t)PAN_STEP_COLUMNS << new_zoom;
+    uint32_t new_pan = pan;
+    
+    pan_wait += samples;
+    if (pan_wait >= PAN_INTERVAL) {
+        pan_wait = 0;
+        if (sw & SW_PAN_OLDER) new_pan += step;
+        if (sw & SW_PAN_NEWER) new_pan = new_pan > step ? new_pan - step : 0;
+    }
+    if (new_pan > held - span || span > held) new_pan = span < held ? held - span : 0;
+    
+    if (new_zoom == zoom && new_pan == pan) return;
+    zoom = new_zoom;
+    pan = new_pan;
+    update_timebase(record_len);
+    phosphor_clear();
+    sweep_reset();
+    
+    uint32_t t0 = hal_read_cycles();
+    show_view(false);
+    if (!running) {
+        uint32_t cycles = hal_read_cycles() - t0;
+        redraws++;
+        if (cycles > redraw_max) redraw_max = cycles;
+    }
+}
+
+/**
+ * Stop: freeze the capture on display. Acquisition, trigger and
+ * measurements carry on into the live capture in the background.
+ */
+static void scope_stop(void) {
+    running = false;
+    capture_freeze();
+    redraws = 0;
+    redraw_max = 0;
+    vga_scope_set_running(0);
+    frame_stale = true;
+}
+
+/**
+ * Run: back to the live capture, showing its newest samples right away
+ * rather than waiting for the next record. Re-arms a single shot.
+ */
+static void scope_run(void) {
+    if (redraws > 0) {
+        print("Stopped: ");
+        print_dec(redraws);
+        print(" redraws, max cycles:");
+        print_dec(redraw_max);
+        print("\n");
+    }
+    running = true;
+    capture_thaw();
+    if (trigger_state() == TRIG_STATE_STOPPED) trigger_arm();
+    view_end = capture_count();
+    vga_scope_set_running(1);
+    refresh_view();
+}
+
+/**
+ * Switch between the live input and replay of the recording. Either
+ * source starts over with an empty capture, a re-armed trigger and a
+ * fresh frequency measurement, running. Going live starts a new
+ * recording; replay needs one.
+ */
+static void set_source(bool replay, const trigger_config_t *trig) {
+    if (replay) {
+        recorder_stop(sample_rate_mhz * filter.decimation);
+        recorder_stats_t rec;
+        recorder_get_stats(&rec);
+        if (rec.samples == 0) return;
+        recorder_rewind();
+        replay_rate_mhz = rec.sample_rate_mhz;
+    } else {
+        recorder_start();
+    }
+    replaying = replay;
+    vga_scope_set_channel(2, show_ch2());
+    vga_scope_set_math(show_math() ? math_name(math) : "", math_vdiv_mv());
+    
+    filter_init(&filter, filter.type);
+    math_reset();
+    reset_xy();
+    capture_reset();
+    freq_reset();
+    trigger_init(trig);
+    view_end = 0;
+    pan = 0;
+    running = true;
+    phosphor_clear();
+    sweep_reset();
+    stats_window_reset(&window_stats[0]);
+    stats_window_reset(&window_stats[1]);
+    stats_window_reset(&window_stats[2]);
+    vga_scope_set_running(1);
+    refresh_view();
+}
+
+/**
+ * Compose a complete frame off screen and queue it for the next vsync
+ */
+static void render_frame(void) {
+    vga_begin_frame();
+    if (show_xy()) {
+        vga_draw_grid();
+        xy_draw();
+    } else {
+        if (phosphor_shown) {
+            phosphor_draw();    // Everything inside the grid border
+        } else {
+            vga_draw_grid();
+            vga_draw_envelope(wave_min, wave_max, grat_left, grat_right, COLOR_WAVEFORM);
+        }
+        if (show_ch2()) {
+            vga_draw_envelope(wave2_min, wave2_max, grat_left, grat_right, COLOR_WAVEFORM2);
+        }
+        if (show_math()) {
+            vga_draw_envelope(wave3_min, wave3_max, grat_left, grat_right, COLOR_MATH);
+        }
+        if (!spectrum) vga_draw_trigger_marker();
+    }
+    vga_draw_header();
+    vga_draw_footer();
+    vga_present();
+    frame_stale = false;
+}
+
+/**
+ * End of record: report, and start the next sweep's statistics
+ */
+static void finish_record(uint16_t adc_raw, uint32_t frame) {
+    // Debug output every 10 frames
+    if (frame % 10 == 0) {
+        stats_result_t st;
+        stats_compute(&sweep_stats[0], &st);
+        print("Frame ");
+        print_dec(frame);
+        print(" ADC:");
+        print_dec(adc_raw);
+        print(" Vpp uV:");
+        print_dec(st.vpp_uv);
+        print(" Mean uV:");
+        print_dec(st.mean_uv);
+        print(" RMS uV:");
+        print_dec(st.rms_uv);
+        print(" AC RMS uV:");
+        print_dec(st.ac_rms_uv);
+        print(" SD uV:");
+        print_dec(st.std_dev_uv);
+        print(" Min uV:");
+        print_dec(st.min_uv);
+        print("@");
+        print_dec(st.min_at - sweep_stats[0].start);
+        print(" Max uV:");
+        print_dec(st.max_uv);
+        print("@");
+        print_dec(st.max_at - sweep_stats[0].start);
+        print(" Ovr:");
+        print_dec(acquisition_overruns());
+        if (show_math()) {
+            print(" Math ");
+            print((char *)math_name(math));
+            print(" Vpp uV:");
+            print_dec(stats_value_about(&sweep_stats[2], STATS_VPP, MATH_ZERO) * (1 << math_shift(math)));
+            print(" RMS uV:");
+            print_dec(stats_value_about(&sweep_stats[2], STATS_RMS, MATH_ZERO) * (1 << math_shift(math)));
+        }
+        if (spectrum) {
+            print(" FFT cycles:");
+            print_dec(fft_cycles);
+        }
+        if (xy_points > 0) {
+            uint32_t writes = xy_pixel_writes();
+            print(" XY points:");
+            print_dec(xy_points);
+            print(" Pixels/point:");
+            print_dec((writes - xy_writes_mark) / xy_points);
+            xy_points = 0;
+            xy_writes_mark = writes;
+        }
+        if (filter_samples > 0) {
+            print(" Filter cycles/sample:");
+            print_dec(filter_cycles / filter_samples);
+            print(" max:");
+            print_dec(filter_peak);
+            filter_cycles = 0;
+            filter_samples = 0;
+            filter_peak = 0;
+        }
+        for (int ch = 0; ch < (dual ? 2 : 1); ch++) {
+            acq_timebase_t tb;
+            acquisition_get_timebase(ch == 0 ? CHN_AIN1 : CHN_AIN2, &tb);
+            print(ch == 0 ? " Rate mHz:" : " CH2 rate mHz:");
+            print_dec(ch == 0 ? sample_rate_mhz : tb.rate_mhz);
+            print(" Interval us:");
+            print_dec(CYCLES_TO_US(tb.interval_cycles));
+            print(" (");
+            print_dec(CYCLES_TO_US(tb.interval_min));
+            print("..");
+            print_dec(CYCLES_TO_US(tb.interval_max));
+            print(") Jitter us:");
+            print_dec(CYCLES_TO_US(tb.jitter_cycles));
+        }
+        if (freq_mhz > 0) {
+            print(" Freq mHz:");
+            print_dec(freq_mhz);
+            print(" Period us:");
+            print_dec((uint32_t)((uint64_t)freq.period_q16 * 1000000000ULL /
+                                 ((uint64_t)sample_rate_mhz << 16)));
+            print(" Duty:");
+            print_dec(freq.duty_permille);
+        }
+        
+        ad7705_bus_stats_t bus;
+        ad7705_get_bus_stats(&bus);
+        if (bus.samples > 0) {
+            print(" SPI bytes/sample:");
+            print_dec(bus.spi_bytes / bus.samples);
+            print(" CS/sample:");
+            print_dec(bus.cs_assertions / bus.samples);
+            print(" Cycles/read:");
+            print_dec(bus.read_cycles / bus.samples);
+        }
+        if (dual && bus.samples > 0) {
+            print(" Switches/100 samples:");
+            print_dec((uint32_t)((uint64_t)acquisition_switches() * 100 / bus.samples));
+        }
+        vga_frame_stats_t fs;
+        vga_get_frame_stats(&fs);
+        if (fs.frames > 0) {
+            print(" Frames:");
+            print_dec(fs.frames);
+            print(" Compose cycles:");
+            print_dec(fs.compose_cycles / fs.frames);
+            print(" Swap cycles:");
+            print_dec(fs.swap_cycles / fs.frames);
+            vga_reset_frame_stats();
+        }
+        recorder_stats_t rec;
+        recorder_get_stats(&rec);
+        if (rec.samples > 0 && rec.bytes > 0) {
+            char ratio[FIXED_FORMAT_MAX];
+            fixed_format(ratio, (int32_t)((uint64_t)rec.samples * 200 / rec.bytes), 2, 2);
+            print(replaying ? " Replay samples:" : " Rec samples:");
+            print_dec(rec.samples);
+            print(" Ratio:");
+            print(ratio);
+            print(" Encode cycles/sample:");
+            print_dec(rec.encode_cycles / rec.samples);
+        }
+#if VGA_SHADOW_FRAMEBUFFER
+        uint32_t vga_words = vga_get_flush_words();
+        print(" VGA words/frame:");
+        print_dec((vga_words - vga_words_mark) / 10);
+        vga_words_mark = vga_words;
+#endif
+        print("\n");
+    }
+    
+    reset_statistics();
 }
 
 // ============================================================================
@@ -69,106 +763,263 @@ int main(void) {
     display_string("\n=== DE10-Lite Oscilloscope ===\n\n");
     
     // Initialize peripherals
-    display_string("Init timer...\n");
-    timer_init(200);  // 200 Hz sample rate
-    
     display_string("Init SPI...\n");
     spi_init();
     delay_ms(100);
     
+    // Setup switches count only with switch 9 on
+    int setup = get_sw();
+    if (!(setup & SW_SETUP)) setup = 0;
+    
     display_string("Init AD7705...\n");
-    ad7705_init(CHN_AIN1);
+    dual = (setup & SW_DUAL_CHANNEL) != 0;
+    if (dual) {
+        // Calibrate AIN2's pair first so the part is left on AIN1
+        ad7705_init(CHN_AIN2);
+        ad7705_calibrate(CHN_AIN1);
+    } else {
+        ad7705_init(CHN_AIN1);
+    }
+    ad7705_set_drdy_mode(DRDY_MODE_PIN);
     delay_ms(100);
     
     // Initialize VGA with oscilloscope display
     display_string("Init VGA...\n");
+    if (setup & SW_DOUBLE_BUFFER) {
+        vga_set_render_mode(VGA_MODE_DOUBLE_BUFFER);
+    }
+    vga_scope_set_channel(2, dual);
     vga_scope_init();
+    vga_words_mark = vga_get_flush_words();
     
     // Get graticule bounds
     vga_get_waveform_bounds(&grat_top, &grat_bottom, &grat_left, &grat_right);
-    current_x = grat_left;
     
     // Initialize buffer
     for (int i = 0; i < SCREEN_WIDTH; i++) {
-        waveform_buffer[i] = 32768;  // Mid-scale
+        wave_min[i] = 32768;  // Mid-scale
+        wave_max[i] = 32768;
+        wave2_min[i] = 65535;   // Empty until the first view
+        wave2_max[i] = 0;
+        wave3_min[i] = 65535;
+        wave3_max[i] = 0;
+    }
+    
+    // Trigger: record spans the waveform area with the trigger point centred
+    trigger_config_t trig = {
+        .level = TRIG_LEVEL,
+        .hysteresis = TRIG_HYSTERESIS,
+        .edge = (setup & SW_TRIG_FALLING) ? TRIG_EDGE_FALLING : TRIG_EDGE_RISING,
+        .mode = (setup & SW_TRIG_SINGLE) ? TRIG_MODE_SINGLE :
+                (setup & SW_TRIG_NORMAL) ? TRIG_MODE_NORMAL : TRIG_MODE_AUTO,
+        .record_len = grat_right - grat_left + 1,
+        .pre_samples = (grat_right - grat_left + 1) / 2,
+        .holdoff = 0,
+        .auto_timeout = grat_right - grat_left + 1,
+    };
+    trigger_init(&trig);
+    vga_scope_set_trigger(TRIG_LEVEL);
+    freq_reset();
+    capture_reset();
+    phosphor_clear();
+    sweep_reset();
+    spectrum = (setup & SW_SPECTRUM) != 0;
+    filter_init(&filter, dual ? FILTER_NONE : (setup >> SW_FILTER_SHIFT) & SW_FILTER_MASK);
+    vga_scope_set_filter(filter_name(filter.type));
+    if (dual && !spectrum) math = (setup >> SW_MATH_SHIFT) & SW_MATH_MASK;
+    xy_mode = math == SW_MATH_XY;
+    if (math >= MATH_COUNT) math = MATH_NONE;
+    math_set(math);
+    vga_scope_set_math(math_name(math), math_vdiv_mv());
+    reset_xy();
+    sample_rate_mhz = dual ? ADC_DUAL_NOMINAL_MHZ : ADC_NOMINAL_MHZ / filter.decimation;
+    reset_statistics();
+    stats_window_reset(&window_stats[0]);
+    stats_window_reset(&window_stats[1]);
+    stats_window_reset(&window_stats[2]);
+    update_measurements(trig.record_len);
+    vga_scope_update_info_fixed(1, 0, MV_PER_DIV, time_per_div_us, 0, 0);
+    vga_scope_update_info_fixed(2, 0, MV_PER_DIV, time_per_div_us, 0, 0);
+    
+    // From here on the SPI bus belongs to the timer interrupt
+    display_string("Start acquisition...\n");
+    ad7705_reset_bus_stats();
+    if (dual) {
+        acquisition_start_dual(ACQ_TICK_HZ, ACQ_DUAL_BLOCK);
+    } else {
+        acquisition_start(CHN_AIN1, ACQ_TICK_HZ);
     }
+    recorder_start();
     
     display_string("Ready!\n\n");
     
     // ========================================================================
-    // Main Loop
+    // Main Loop - consumer only, samples arrive from the timer interrupt
     // ========================================================================
     
     uint32_t frame = 0;
+    uint16_t popped[RENDER_BATCH];
+    uint8_t channels[RENDER_BATCH];
+    uint16_t live[RENDER_BATCH];
+    uint16_t held[RENDER_BATCH];    // CH2 as it stood at each CH1 sample
+    uint16_t ch2 = 32768;
+    uint16_t replay[RENDER_BATCH << SW_SPEED_MASK];
+    int last_btn = 0;
+    int sw = get_sw();
+    int last_sw = (sw & SW_SETUP) ? 0 : sw;   // Run controls as last read
+    int since_measure = 0;
+    int since_spectrum = 0;
+    int speed = 0;
     
     while (1) {
-        // Read ADC
-        uint16_t adc_raw = ad7705_read_data(CHN_AIN1);
+        int n = acquisition_pop_batch_tagged(popped, 0, channels, RENDER_BATCH);
+        if (n == 0) {
+            hal_idle();
+            continue;
+        }
+        
+        // Split off CH2, holding its latest sample against each CH1 one
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            if (channels[i] == CHN_AIN2) {
+                ch2 = popped[i];
+                update_statistics(1, ch2);
+                continue;
+            }
+            live[m] = popped[i];
+            held[m++] = ch2;
+        }
+        n = m;
+        if (n == 0) continue;
         
-        // Update stats
-        update_statistics(adc_raw);
+        // Live samples pace the replay: 2^speed recorded samples each
+        uint16_t *batch = live;
+        if (replaying) {
+            n = recorder_read(replay, n << speed);
+            batch = replay;
+        } else {
+            for (int i = 0; i < n; i++) {
+                recorder_put(live[i]);
+            }
+        }
         
-        // LED feedback (upper 8 bits)
-        set_leds(adc_raw >> 8);
+        // Filter in place ahead of the trigger, the capture and the
+        // measurements; the recording keeps the input as it came
+        if (filter.type != FILTER_NONE) {
+            uint32_t t0 = hal_read_cycles();
+            int in = n;
+            n = filter_process(&filter, batch, batch, n);
+            uint32_t cycles = hal_read_cycles() - t0;
+            filter_cycles += cycles;
+            filter_samples += in;
+            if (cycles / in > filter_peak) filter_peak = cycles / in;
+            if (n == 0) continue;
+        }
         
-        // === Draw waveform ===
+        for (int i = 0; i < n; i++) {
+            update_statistics(0, batch[i]);
+            freq_feed(batch[i]);
+            if (show_ch2()) capture_feed_pair(batch[i], held[i]);
+            else capture_feed(batch[i]);
+            if (show_xy() && running) {
+                xy_add(batch[i], held[i]);
+                xy_points++;
+            }
+            if (show_math()) {
+                uint16_t math_sample = math_feed(batch[i], held[i]);
+                capture_feed_math(math_sample);
+                update_statistics(2, math_sample);
+            }
+            
+            if (trigger_feed(batch[i]) && running) {
+                frame++;
+                view_end = capture_count();
+                if (!spectrum && !show_xy()) {
+                    if (persist) phosphor_decay(PHOSPHOR_DECAY_SHIFT);
+                    show_view(true);
+                }
+                finish_record(batch[i], frame);
+                // A single shot stops the scope on its record
+                if (trigger_state() == TRIG_STATE_STOPPED) scope_stop();
+            }
+        }
         
-        // Erase old column and restore grid
-        vga_erase_column(current_x);
+        if (show_xy() && running) frame_stale = true;
         
-        // Get previous sample
-        int prev_x = (current_x == grat_left) ? grat_right : current_x - 1;
-        uint16_t prev_adc = waveform_buffer[prev_x];
+        since_spectrum += n;
+        if (spectrum && since_spectrum >= SPECTRUM_HOP && running) {
+            since_spectrum = 0;
+            show_spectrum();
+        }
         
-        // Draw segment
-        if (current_x > grat_left) {
-            vga_draw_waveform_segment(prev_x, prev_adc, current_x, adc_raw, COLOR_WAVEFORM);
-        } else {
-            // First point of new sweep
-            int y = vga_adc_to_screen_y(adc_raw);
-            vga_draw_pixel(current_x, y, COLOR_WAVEFORM);
+        since_measure += n;
+        if (since_measure >= MEASURE_INTERVAL && running) {
+            since_measure = 0;
+            update_measurements(trig.record_len);
+            frame_stale = true;
         }
         
-        // Store sample
-        waveform_buffer[current_x] = adc_raw;
+        uint8_t status = trigger_status();
+        vga_scope_set_trigger_status(status);
         
-        // Advance position
-        current_x++;
-        if (current_x > grat_right) {
-            current_x = grat_left;
-            
-            // Update header once per sweep
-            float v_current = adc_to_voltage(adc_raw);
-            float v_max = adc_to_voltage(adc_max);
-            float v_min = adc_to_voltage(adc_min);
-            
-            vga_scope_update_info(1, v_current, VOLTS_PER_DIV, 
-                                  TIME_PER_DIV_MS, v_max, v_min);
-            
-            // Debug output every 10 frames
-            frame++;
-            if (frame % 10 == 0) {
-                print("Frame ");
-                print_dec(frame);
-                print(" ADC:");
-                print_dec(adc_raw);
-                print(" Vpp:");
-                print_dec(adc_max - adc_min);
-                print("\n");
+        if (vga_get_render_mode() == VGA_MODE_DOUBLE_BUFFER) {
+            static uint8_t shown_status = TRIG_STATUS_READY;
+            if (status != shown_status) {
+                shown_status = status;
+                frame_stale = true;
             }
-            
-            reset_statistics();
+            // New frame once the last one is on screen (at most 60 Hz)
+            if (frame_stale && !vga_swap_pending()) render_frame();
+        } else {
+            // Push this batch's columns (and any footer update) to the screen
+            vga_flush();
         }
         
+        // LED feedback (upper 8 bits of the newest sample)
+        set_leds(batch[n - 1] >> 8);
+        
         // === Handle user input ===
-        int sw = get_sw();
-        if (sw & 0x01) {
-            // Switch 0: Change time scale (placeholder)
+        // The button toggles Run/Stop
+        int btn = get_btn();
+        if (btn && !last_btn) {
+            if (running) scope_stop();
+            else scope_run();
+        }
+        last_btn = btn;
+        
+        // In setup the run controls keep the positions they had before
+        sw = get_sw();
+        if (sw & SW_SETUP) sw = last_sw;
+        if ((sw ^ last_sw) & SW_MEASUREMENT) {
+            measurement = (measurement + 1) % STATS_COUNT;
+            show_measurement();
         }
-        if (sw & 0x02) {
-            // Switch 1: Change voltage scale (placeholder)
+        last_sw = sw;
+        if (!(sw & SW_REPLAY) != !replaying) {
+            set_source(sw & SW_REPLAY, &trig);
         }
+        if (!(sw & SW_PERSIST) != !persist) {
+            persist = (sw & SW_PERSIST) != 0;
+            phosphor_clear();
+            if (xy_mode) reset_xy();
+            refresh_view();
+        }
+        speed = replaying ? (sw >> SW_SPEED_SHIFT) & SW_SPEED_MASK : 0;
+        int new_acquire = replaying || spectrum || xy_mode ? VGA_ACQ_NORMAL :
+                          (sw >> SW_ACQUIRE_SHIFT) & SW_ACQUIRE_MASK;
+        if (new_acquire != acquire) {
+            acquire = new_acquire;
+            sweep_reset();
+            vga_scope_set_acquire(acquire, SWEEP_AVERAGE);
+            show_view(false);
+        }
+        vga_scope_set_source(replaying ? VGA_SOURCE_REPLAY :
+                             recorder_recording() ? VGA_SOURCE_RECORDING : VGA_SOURCE_LIVE,
+                             1 << speed);
+        if (spectrum) update_spectrum_view(sw, trig.record_len);
+        else if (show_xy()) update_xy_view(sw);
+        else update_view(sw, n, trig.record_len);
     }
     
     return 0;
-}
\ No newline at end of file
+}
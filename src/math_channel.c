@@ -0,0 +1,81 @@
+/**
+ * math_channel.c - Math trace computed on the sample stream
+ *
+ * The integral keeps its full sum, at most 2^MATH_LEAK_SHIFT times a
+ * half-scale input, so neither the state nor, scaled back down by as
+ * much, the output ever saturates.
+ */
+
+#include "math_channel.h"
+
+// Names for the display, 3 characters at most
+static const char *const names[MATH_COUNT] = {
+    [MATH_NONE]     = "",
+    [MATH_DIFF]     = "A-B",
+    [MATH_SUM]      = "A+B",
+    [MATH_DERIV]    = "dA",
+    [MATH_INTEGRAL] = "IA",
+};
+
+static int function = MATH_NONE;
+static int32_t last;                // Previous CH1 sample about zero
+static int32_t integral;            // Sum of CH1 about zero, leaking
+static bool primed;                 // last holds a sample
+
+static inline uint16_t sat_code(int32_t v) {
+    v += MATH_ZERO;
+    if (v < 0) return 0;
+    if (v > 65535) return 65535;
+    return (uint16_t)v;
+}
+
+void math_set(int f) {
+    function = f >= 0 && f < MATH_COUNT ? f : MATH_NONE;
+    math_reset();
+}
+
+/**
+ * Forget the previous sample and the integral, for a new source
+ */
+void math_reset(void) {
+    last = 0;
+    integral = 0;
+    primed = false;
+}
+
+uint16_t math_feed(uint16_t ch1, uint16_t ch2) {
+    int32_t a = (int32_t)ch1 - MATH_ZERO;
+    int32_t b = (int32_t)ch2 - MATH_ZERO;
+    int32_t v = 0;
+
+    switch (function) {
+    case MATH_DIFF:
+        v = (a - b) >> MATH_SUM_SHIFT;
+        break;
+    case MATH_SUM:
+        v = (a + b) >> MATH_SUM_SHIFT;
+        break;
+    case MATH_DERIV:
+        v = primed ? (a - last) * (1 << MATH_DERIV_SHIFT) : 0;
+        break;
+    case MATH_INTEGRAL:
+        integral += a - (integral >> MATH_LEAK_SHIFT);
+        v = integral >> MATH_INTEGRAL_SHIFT;
+        break;
+    }
+    last = a;
+    primed = true;
+    return sat_code(v);
+}
+
+/**
+ * Bits the trace of f is scaled down by: its values and V/div are
+ * 2^math_shift(f) times what its codes read at the channels' scale
+ */
+int math_shift(int f) {
+    return f == MATH_DIFF || f == MATH_SUM ? MATH_SUM_SHIFT : 0;
+}
+
+const char *math_name(int f) {
+    return names[f];
+}
@@ -0,0 +1,52 @@
+/**
+ * math_channel.h - Math trace computed on the sample stream
+ *
+ * math_feed() takes each CH1 sample with the CH2 sample held against it
+ * and returns one math sample, in O(1) with no history beyond the last
+ * sample and the integral. Inputs are taken about mid-scale, the level
+ * the trigger treats as zero, and the result is shown about mid-scale as
+ * well, so the math trace's zero is the centre line. Everything is in
+ * 32-bit integers and saturates to the ADC range.
+ *
+ * The sum and difference of two full-scale inputs span twice the ADC
+ * range, so they are halved: their trace reads at 2^MATH_SUM_SHIFT times
+ * the channels' V/div, and math_shift() tells the readouts to scale back.
+ *
+ * The derivative and the integral are scaled to be visible at the
+ * channels' V/div at the dual-channel rate, about 71 S/s: the derivative
+ * is the step per sample times 2^MATH_DERIV_SHIFT, the integral is the
+ * sum of samples divided by 2^MATH_INTEGRAL_SHIFT, leaking
+ * 2^-MATH_LEAK_SHIFT of itself per sample. With the two shifts equal the
+ * integral's gain is 1 for DC and less above it, so no input, full scale
+ * included, runs it into the rail; above the corner, 0.35 Hz at 71 S/s,
+ * it integrates. Only the derivative saturates, on steps of more than
+ * 2^(15 - MATH_DERIV_SHIFT) codes per sample.
+ */
+
+#ifndef MATH_CHANNEL_H
+#define MATH_CHANNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Math functions
+#define MATH_NONE           0
+#define MATH_DIFF           1   // CH1 - CH2
+#define MATH_SUM            2   // CH1 + CH2
+#define MATH_DERIV          3   // d(CH1)/dt
+#define MATH_INTEGRAL       4   // Leaky running integral of CH1
+#define MATH_COUNT          5
+
+#define MATH_ZERO           32768   // Code of zero, in and out
+#define MATH_SUM_SHIFT      1       // A+B and A-B halved to stay in range
+#define MATH_DERIV_SHIFT    2       // A 2.8 Hz sine keeps its amplitude
+#define MATH_INTEGRAL_SHIFT 5       // A 0.35 Hz sine keeps about 0.7 of it
+#define MATH_LEAK_SHIFT     5       // Time constant 32 samples, DC gain 1
+
+void math_set(int function);
+void math_reset(void);
+uint16_t math_feed(uint16_t ch1, uint16_t ch2);
+int math_shift(int function);
+const char *math_name(int function);
+
+#endif // MATH_CHANNEL_H
@@ -0,0 +1,108 @@
+/**
+ * phosphor.c - Intensity-graded persistence display
+ *
+ * Counts are stored column-major like the VGA driver's graticule image,
+ * with a word view so the decay pass handles four pixels per load.
+ */
+
+#include "phosphor.h"
+
+#define COUNT_BYTES         (PHOSPHOR_WIDTH * PHOSPHOR_HEIGHT)
+
+#if COUNT_BYTES % 4 != 0
+#error "phosphor counts must fill whole words"
+#endif
+
+static union {
+    uint8_t px[PHOSPHOR_WIDTH][PHOSPHOR_HEIGHT];
+    uint32_t words[COUNT_BYTES / 4];
+} counts;
+
+// Count to RGB332, dim blue through to white. Count 0 shows the graticule.
+static const uint8_t ramp[256] = {
+    [0]          = COLOR_BLACK,
+    [1 ... 15]   = COLOR_BLUE,
+    [16 ... 39]  = COLOR_CYAN,
+    [40 ... 79]  = COLOR_GREEN,
+    [80 ... 159] = COLOR_YELLOW,
+    [160 ... 255] = COLOR_WHITE,
+};
+
+static int top_row;                 // Screen row of counts row 0
+static int left_col;                // Screen column of counts column 0
+
+void phosphor_clear(void) {
+    for (int i = 0; i < COUNT_BYTES / 4; i++) {
+        counts.words[i] = 0;
+    }
+    vga_get_waveform_bounds(&top_row, 0, &left_col, 0);
+}
+
+static inline void hit(uint8_t *col, int row) {
+    uint8_t c = col[row];
+    col[row] = c > 255 - PHOSPHOR_HIT ? 255 : c + PHOSPHOR_HIT;
+}
+
+/**
+ * Add a min/max envelope indexed by screen column, covering the same
+ * pixels vga_draw_envelope() would draw. Columns with min > max are
+ * skipped.
+ */
+void phosphor_add_envelope(const uint16_t *mins, const uint16_t *maxs,
+                           int x_first, int x_last) {
+    if (x_first < left_col) x_first = left_col;
+    if (x_last > left_col + PHOSPHOR_WIDTH - 1) x_last = left_col + PHOSPHOR_WIDTH - 1;
+    
+    int have_prev = 0;
+    int prev_top = 0, prev_bottom = 0;
+    for (int x = x_first; x <= x_last; x++) {
+        if (mins[x] > maxs[x]) {
+            have_prev = 0;
+            continue;
+        }
+        int y_top = vga_adc_to_screen_y(maxs[x]) - top_row;
+        int y_bottom = vga_adc_to_screen_y(mins[x]) - top_row;
+        int top = y_top, bottom = y_bottom;
+        if (have_prev) {
+            if (top > prev_bottom + 1) top = prev_bottom + 1;
+            if (bottom < prev_top - 1) bottom = prev_top - 1;
+        }
+        uint8_t *col = counts.px[x - left_col];
+        for (int row = top; row <= bottom; row++) {
+            hit(col, row);
+        }
+        have_prev = 1;
+        prev_top = y_top;
+        prev_bottom = y_bottom;
+    }
+}
+
+/**
+ * Fade every count by c >> shift and one more, so counts below 2^shift
+ * still reach zero. Four counts per word: no byte can borrow from its
+ * neighbour because neither subtraction takes it below zero. Empty words,
+ * most of the area, cost a load and a branch.
+ */
+void phosphor_decay(int shift) {
+    uint32_t keep = 0x01010101u * (0xFFu >> shift);
+    
+    for (int i = 0; i < COUNT_BYTES / 4; i++) {
+        uint32_t w = counts.words[i];
+        if (w == 0) continue;
+        // 0x01 in every byte that is nonzero
+        uint32_t nonzero = (((w & 0x7F7F7F7Fu) + 0x7F7F7F7Fu) | w) >> 7 & 0x01010101u;
+        counts.words[i] = w - ((w >> shift) & keep) - nonzero;
+    }
+}
+
+/**
+ * Paint the waveform area from the counts, the graticule wherever the
+ * count is zero
+ */
+void phosphor_draw(void) {
+    vga_draw_intensity(&counts.px[0][0], ramp);
+}
+
+const uint8_t *phosphor_counts(void) {
+    return &counts.px[0][0];
+}
@@ -0,0 +1,35 @@
+/**
+ * phosphor.h - Intensity-graded persistence display
+ *
+ * Keeps a hit counter per pixel of the waveform area. Every trace added
+ * bumps the counters it covers, phosphor_decay() fades them all
+ * exponentially, and phosphor_draw() paints the area with each count
+ * mapped through an intensity ramp, so rarely hit pixels glow dim and
+ * the trace a signal keeps returning to glows bright. Noise and jitter
+ * show up as a spread rather than the latest sweep overwriting the last.
+ */
+
+#ifndef PHOSPHOR_H
+#define PHOSPHOR_H
+
+#include <stdint.h>
+#include "vga_driver.h"
+
+// One byte per pixel of the waveform area (62 KB)
+#define PHOSPHOR_WIDTH      VGA_WAVEFORM_WIDTH
+#define PHOSPHOR_HEIGHT     VGA_WAVEFORM_HEIGHT
+
+// Added to a pixel's count for each trace that covers it, saturating
+#define PHOSPHOR_HIT        32
+
+// Each decay keeps 1 - 1/2^n of every count
+#define PHOSPHOR_DECAY_SHIFT 2
+
+void phosphor_clear(void);
+void phosphor_add_envelope(const uint16_t *mins, const uint16_t *maxs,
+                           int x_first, int x_last);
+void phosphor_decay(int shift);
+void phosphor_draw(void);
+const uint8_t *phosphor_counts(void);
+
+#endif // PHOSPHOR_H
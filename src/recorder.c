@@ -0,0 +1,135 @@
+/**
+ * recorder.c - Compressed sample recording and replay
+ */
+
+#include "recorder.h"
+#include "hal.h"
+
+static uint8_t buffer[RECORDER_BYTES];
+
+static bool recording;
+static uint32_t write_pos;          // Bytes written
+static uint16_t write_prev;         // Last sample recorded
+static recorder_stats_t stats;
+
+static uint32_t read_pos;           // Replay position, bytes
+static uint32_t read_count;         // Samples replayed since the last rewind
+static uint16_t read_prev;          // Last sample replayed
+
+// ============================================================================
+// Codec
+// ============================================================================
+
+/**
+ * Encode sample as the step from prev, returns the bytes written
+ * (1 to RECORDER_MAX_SAMPLE_BYTES)
+ */
+int recorder_encode(uint8_t *out, uint16_t prev, uint16_t sample) {
+    int16_t delta = (int16_t)(uint16_t)(sample - prev);
+    uint32_t zz = ((uint32_t)(int32_t)delta << 1) ^ (uint32_t)(delta >> 15);
+    int n = 0;
+    
+    while (zz >= 0x80) {
+        out[n++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    out[n++] = (uint8_t)zz;
+    return n;
+}
+
+/**
+ * Decode one sample following prev, returns the bytes consumed
+ */
+int recorder_decode(const uint8_t *in, uint16_t prev, uint16_t *sample) {
+    uint32_t zz = in[0] & 0x7F;
+    int n = 1;
+    
+    if (in[0] & 0x80) {
+        zz |= (uint32_t)(in[1] & 0x7F) << 7;
+        n = 2;
+        if (in[1] & 0x80) {
+            zz |= (uint32_t)in[2] << 14;
+            n = 3;
+        }
+    }
+    int32_t delta = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+    *sample = (uint16_t)(prev + delta);
+    return n;
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+/**
+ * Start a new recording, discarding the previous one
+ */
+void recorder_start(void) {
+    recording = true;
+    write_pos = 0;
+    write_prev = 0;
+    stats = (recorder_stats_t){0};
+    recorder_rewind();
+}
+
+/**
+ * Append one sample. Returns false, and ends the recording, once the
+ * buffer is full.
+ */
+bool recorder_put(uint16_t sample) {
+    if (!recording) return false;
+    if (write_pos > RECORDER_BYTES - RECORDER_MAX_SAMPLE_BYTES) {
+        recording = false;
+        return false;
+    }
+    
+    uint32_t t0 = hal_read_cycles();
+    write_pos += recorder_encode(&buffer[write_pos], write_prev, sample);
+    write_prev = sample;
+    stats.samples++;
+    stats.encode_cycles += hal_read_cycles() - t0;
+    return true;
+}
+
+/**
+ * End the recording and note the rate it was taken at, for replay
+ */
+void recorder_stop(uint32_t sample_rate_mhz) {
+    recording = false;
+    stats.sample_rate_mhz = sample_rate_mhz;
+}
+
+bool recorder_recording(void) {
+    return recording;
+}
+
+void recorder_get_stats(recorder_stats_t *out) {
+    *out = stats;
+    out->bytes = write_pos;
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+void recorder_rewind(void) {
+    read_pos = 0;
+    read_count = 0;
+    read_prev = 0;
+}
+
+/**
+ * Replay up to max samples, wrapping to the start at the end of the
+ * recording. Returns 0 only if there is nothing recorded.
+ */
+int recorder_read(uint16_t *samples, int max) {
+    if (stats.samples == 0) return 0;
+    
+    for (int i = 0; i < max; i++) {
+        if (read_count == stats.samples) recorder_rewind();
+        read_pos += recorder_decode(&buffer[read_pos], read_prev, &read_prev);
+        read_count++;
+        samples[i] = read_prev;
+    }
+    return max;
+}
@@ -0,0 +1,49 @@
+/**
+ * recorder.h - Compressed sample recording and replay
+ *
+ * Samples are stored as the difference to the previous sample, taken
+ * modulo 2^16, zigzag-mapped so small steps either way become small
+ * unsigned numbers and packed 7 bits per byte with the top bit marking a
+ * continuation (LEB128). A step under 64 codes takes one byte, under
+ * 8192 two, anything else three. Quiet or slowly moving inputs cost
+ * about half of the raw 16 bits; no input costs more than 24.
+ *
+ * One recording at a time lives in RAM. Replay decodes it in order,
+ * starting over at the end.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Recording buffer: at least 1.4M samples, 46 minutes at 500 S/s
+#define RECORDER_BYTES          (4u << 20)
+
+// Longest encoding of one sample
+#define RECORDER_MAX_SAMPLE_BYTES   3
+
+typedef struct {
+    uint32_t samples;           // Samples recorded
+    uint32_t bytes;             // Encoded size
+    uint32_t encode_cycles;     // Cycles spent in recorder_put()
+    uint32_t sample_rate_mhz;   // Rate the samples were taken at
+} recorder_stats_t;
+
+// Codec
+int recorder_encode(uint8_t *out, uint16_t prev, uint16_t sample);
+int recorder_decode(const uint8_t *in, uint16_t prev, uint16_t *sample);
+
+// Recording
+void recorder_start(void);
+bool recorder_put(uint16_t sample);
+void recorder_stop(uint32_t sample_rate_mhz);
+bool recorder_recording(void);
+void recorder_get_stats(recorder_stats_t *stats);
+
+// Replay
+void recorder_rewind(void);
+int recorder_read(uint16_t *samples, int max);
+
+#endif // RECORDER_H
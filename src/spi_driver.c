@@ -9,8 +9,10 @@
  * - MSB first
  */
 
+#include <stddef.h>
 #include "spi_driver.h"
 #include "hardware.h" 
+#include "hal.h"
 #include "dtekv-lib.h"
 #include "lib.h"
 #include "delay.h"
@@ -18,11 +20,22 @@
 // Track output state to avoid read-modify-write races
 static uint32_t pio_output_state;
 
-// Minimum SPI clock half-period delay
+// Bus activity counters, read by the ADC driver for per-sample cost
+static uint32_t spi_byte_count;
+static uint32_t spi_select_count;
+
+// SPI timing, converted to CPU cycles at compile time
 // AD7705 max SCLK is 2.1 MHz, so half-period >= 238ns
-// Using 500ns for safety margin
+#define SPI_SCLK_HALF_NS        240
+// Each phase already spends the cycle count read after its edge and the
+// GPIO store ending it, at least a cycle each, outside the wait
+#define SPI_EDGE_CYCLES         2
+#define SPI_SCLK_HALF_CYCLES    (NS_TO_CYCLES(SPI_SCLK_HALF_NS) - SPI_EDGE_CYCLES)
+// CS setup/hold around a frame, keeps the old 500ns margin
+#define SPI_CS_DELAY_CYCLES     NS_TO_CYCLES(500)
+
 static void spi_delay(void) {
-    delay_ns(500);
+    delay_cycles(SPI_CS_DELAY_CYCLES);
 }
 
 /**
@@ -32,24 +45,24 @@ void spi_init(void) {
     display_string("SPI init...\n");
     
     // Read current direction register
-    uint32_t direction = *pGPIO_DIRECTION;
+    uint32_t direction = hal_read32(GPIO_DIRECTION);
 
     // Set pin directions:
     // Outputs: CS, SCK, MOSI, RST
     // Inputs:  MISO, DRDY
     direction |= (SPI_CS_PIN | SPI_SCK_PIN | SPI_MOSI_PIN | ADC_RST_PIN);
     direction &= ~(SPI_MISO_PIN | ADC_DRDY_PIN);
-    *pGPIO_DIRECTION = direction;
+    hal_write32(GPIO_DIRECTION, direction);
 
     // Set initial pin states for SPI Mode 3:
     // - SCK: High (idle state for CPOL=1)
     // - CS: High (inactive/deselected)
     // - RST: High (not resetting, RST is active low)
     // - MOSI: Low (doesn't matter when idle)
-    pio_output_state = *pGPIO_DATA;
+    pio_output_state = hal_read32(GPIO_DATA);
     pio_output_state |= (SPI_CS_PIN | ADC_RST_PIN | SPI_SCK_PIN);
     pio_output_state &= ~SPI_MOSI_PIN;
-    *pGPIO_DATA = pio_output_state;
+    hal_write32(GPIO_DATA, pio_output_state);
     
     display_string("SPI init done\n");
 }
@@ -58,8 +71,9 @@ void spi_init(void) {
  * Select the ADC chip (assert CS low)
  */
 void spi_select_chip(void) {
+    spi_select_count++;
     pio_output_state &= ~SPI_CS_PIN;
-    *pGPIO_DATA = pio_output_state;
+    hal_write32(GPIO_DATA, pio_output_state);
     spi_delay();
 }
 
@@ -68,7 +82,7 @@ void spi_select_chip(void) {
  */
 void spi_deselect_chip(void) {
     pio_output_state |= SPI_CS_PIN;
-    *pGPIO_DATA = pio_output_state;
+    hal_write32(GPIO_DATA, pio_output_state);
     spi_delay();
 }
 
@@ -81,7 +95,7 @@ void spi_reset_pin(bool high) {
     } else {
         pio_output_state &= ~ADC_RST_PIN;
     }
-    *pGPIO_DATA = pio_output_state;
+    hal_write32(GPIO_DATA, pio_output_state);
 }
 
 /**
@@ -91,7 +105,7 @@ bool spi_wait_for_ready(void) {
     int timeout = 1000000;
     
     while (timeout > 0) {
-        if ((*pGPIO_DATA & ADC_DRDY_PIN) == 0) {
+        if ((hal_read32(GPIO_DATA) & ADC_DRDY_PIN) == 0) {
             return true;  // DRDY is low, data ready
         }
         timeout--;
@@ -106,9 +120,81 @@ bool spi_wait_for_ready(void) {
  * Check if DRDY is asserted (low)
  */
 bool spi_is_ready(void) {
-    return (*pGPIO_DATA & ADC_DRDY_PIN) == 0;
+    return (hal_read32(GPIO_DATA) & ADC_DRDY_PIN) == 0;
+}
+
+
+// ============================================================================
+// Bit Engine
+// ============================================================================
+
+#define SPI_MOSI_SHIFT  __builtin_ctz(SPI_MOSI_PIN)
+#define SPI_MISO_SHIFT  __builtin_ctz(SPI_MISO_PIN)
+
+/**
+ * One SPI Mode 3 bit: bit n of out goes to MOSI on the falling edge,
+ * MISO is shifted into in after the rising edge.
+ * 
+ * - MOSI is inserted without a branch: low has SCK and MOSI cleared and
+ *   the data bit is shifted straight into the MOSI position
+ * - MISO is taken from a single GPIO load, shifted and masked
+ * - Each SCLK phase lasts at least SPI_SCLK_HALF_CYCLES, timed from the
+ *   cycle count right after the edge, so the bit's own work overlaps
+ *   the wait instead of adding to it
+ * 
+ * Work per bit on rv32im: falling phase 4 ALU ops, 1 store, 1 csrr;
+ * rising phase 1 ALU op, 1 store, 1 csrr, 1 load and 4 ALU ops. The
+ * counter read after an edge and the store ending the phase fall outside
+ * the wait, so the wait is SPI_EDGE_CYCLES short of the 8-cycle half
+ * period, and each phase also overshoots its deadline by up to one turn
+ * of the polling loop. The AD7705 model (2-cycle I/O, 3-cycle poll)
+ * measures 24 cycles per bit, SCLK = 1.25 MHz at 30 MHz, with the
+ * shortest phase 11 cycles (367 ns) against the AD7705's 238 ns. The
+ * 1.875 MHz of a bare 16-cycle period would need the poll overshoot
+ * gone as well, which the 2.1 MHz limit leaves no margin for.
+ */
+#define SPI_BIT(n)                                                          \
+    do {                                                                    \
+        uint32_t state = low | (((out >> (n)) & 1) << SPI_MOSI_SHIFT);      \
+        hal_write32(GPIO_DATA, state);                                      \
+        uint32_t edge = cycles_now();                                       \
+        delay_until(edge + SPI_SCLK_HALF_CYCLES);       /* Setup time */    \
+        hal_write32(GPIO_DATA, state | SPI_SCK_PIN);                        \
+        edge = cycles_now();                                                \
+        in = (in << 1) | ((hal_read32(GPIO_DATA) >> SPI_MISO_SHIFT) & 1);   \
+        delay_until(edge + SPI_SCLK_HALF_CYCLES);       /* Hold time */     \
+    } while (0)
+
+/**
+ * Shift 8 bits, fully unrolled. CS must already be asserted.
+ */
+static inline uint32_t shift_byte(uint32_t out) {
+    uint32_t low = pio_output_state & ~(SPI_SCK_PIN | SPI_MOSI_PIN);
+    uint32_t in = 0;
+    
+    SPI_BIT(7); SPI_BIT(6); SPI_BIT(5); SPI_BIT(4);
+    SPI_BIT(3); SPI_BIT(2); SPI_BIT(1); SPI_BIT(0);
+    
+    // Clock ends high (Mode 3 idle state), MOSI holds the last bit
+    pio_output_state = low | SPI_SCK_PIN | ((out & 1) << SPI_MOSI_SHIFT);
+    return in;
 }
 
+/**
+ * Shift 16 bits MSB first, fully unrolled. CS must already be asserted.
+ */
+static inline uint32_t shift_word(uint32_t out) {
+    uint32_t low = pio_output_state & ~(SPI_SCK_PIN | SPI_MOSI_PIN);
+    uint32_t in = 0;
+    
+    SPI_BIT(15); SPI_BIT(14); SPI_BIT(13); SPI_BIT(12);
+    SPI_BIT(11); SPI_BIT(10); SPI_BIT(9);  SPI_BIT(8);
+    SPI_BIT(7);  SPI_BIT(6);  SPI_BIT(5);  SPI_BIT(4);
+    SPI_BIT(3);  SPI_BIT(2);  SPI_BIT(1);  SPI_BIT(0);
+    
+    pio_output_state = low | SPI_SCK_PIN | ((out & 1) << SPI_MOSI_SHIFT);
+    return in;
+}
 
 /**
  * Transfer one byte over SPI (Mode 3)
@@ -119,39 +205,41 @@ bool spi_is_ready(void) {
  * 3. On rising edge: sample MISO data (CPHA=1)
  */
 uint8_t spi_transfer_byte(uint8_t byte_out) {
-    uint8_t byte_in = 0;
-    
-    for (int i = 0; i < 8; i++) {
-        // Prepare to receive - shift input left BEFORE reading new bit
-        byte_in <<= 1;
-        
-        // === FALLING EDGE: Setup MOSI data ===
-        pio_output_state &= ~SPI_SCK_PIN;  // SCK low
-        
-        // Set MOSI based on MSB of byte_out
-        if (byte_out & 0x80) {
-            pio_output_state |= SPI_MOSI_PIN;
-        } else {
-            pio_output_state &= ~SPI_MOSI_PIN;
-        }
-        byte_out <<= 1;  // Prepare next bit
-        
-        *pGPIO_DATA = pio_output_state;
-        spi_delay();  // Data setup time
-        
-        // === RISING EDGE: Sample MISO data ===
-        pio_output_state |= SPI_SCK_PIN;  // SCK high
-        *pGPIO_DATA = pio_output_state;
-        spi_delay();  // Hold time
-        
-        // Sample MISO after rising edge
-        if (*pGPIO_DATA & SPI_MISO_PIN) {
-            byte_in |= 0x01;
-        }
+    spi_byte_count++;
+    return (uint8_t)shift_byte(byte_out);
+}
+
+/**
+ * Transfer a 16-bit word, MSB first, within the current CS frame
+ */
+uint16_t spi_transfer_word(uint16_t word_out) {
+    spi_byte_count += 2;
+    return (uint16_t)shift_word(word_out);
+}
+
+/**
+ * Transfer len bytes in one CS frame. tx may be NULL to send zeros and
+ * rx may be NULL to discard what comes back.
+ */
+void spi_transfer_buffer(const uint8_t *tx, uint8_t *rx, int len) {
+    spi_select_chip();
+    for (int i = 0; i < len; i++) {
+        uint8_t in = (uint8_t)shift_byte(tx ? tx[i] : 0x00);
+        if (rx) rx[i] = in;
     }
-    
-    // Clock ends high (Mode 3 idle state)
-    return byte_in;
+    spi_byte_count += len;
+    spi_deselect_chip();
+}
+
+/**
+ * Bytes transferred and CS assertions since spi_init
+ */
+uint32_t spi_get_byte_count(void) {
+    return spi_byte_count;
+}
+
+uint32_t spi_get_select_count(void) {
+    return spi_select_count;
 }
 
 /**
@@ -159,15 +247,12 @@ uint8_t spi_transfer_byte(uint8_t byte_out) {
  * This is recommended by AD7705 datasheet to reset serial interface
  */
 void spi_interface_reset(void) {
+    static const uint8_t ones[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
     display_string("SPI interface reset...\n");
-    spi_select_chip();
     
     // Send at least 32 bits of 1s to reset the AD7705 serial interface
-    for (int i = 0; i < 4; i++) {
-        spi_transfer_byte(0xFF);
-    }
+    spi_transfer_buffer(ones, NULL, sizeof(ones));
     
-    spi_deselect_chip();
     delay_ms(1);
     display_string("SPI interface reset done\n");
 }
\ No newline at end of file
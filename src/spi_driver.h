@@ -16,6 +16,10 @@ void spi_reset_pin(bool high);
 bool spi_wait_for_ready(void);
 bool spi_is_ready(void);
 uint8_t spi_transfer_byte(uint8_t byte_out);
+uint16_t spi_transfer_word(uint16_t word_out);
+void spi_transfer_buffer(const uint8_t *tx, uint8_t *rx, int len);
 void spi_interface_reset(void);
+uint32_t spi_get_byte_count(void);
+uint32_t spi_get_select_count(void);
 
 #endif // SPI_DRIVER_H
\ No newline at end of file
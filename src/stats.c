@@ -0,0 +1,160 @@
+/**
+ * stats.c - Incremental voltage statistics
+ *
+ * Results are worked out in raw codes with 8 fractional bits and only
+ * converted to microvolts at the end. A square of a raw code fits in 32
+ * bits, so sumsq cannot overflow before 2^32 samples (over three months
+ * at 500 S/s).
+ */
+
+#include "stats.h"
+#include "ad7705_driver.h"
+#include "fixed.h"
+
+#define WINDOW_MASK         (STATS_WINDOW - 1)
+
+void stats_sums_reset(stats_sums_t *s) {
+    s->n = 0;
+    s->sum = 0;
+    s->sumsq = 0;
+    s->min = 0xFFFF;
+    s->max = 0;
+    s->min_at = s->max_at = s->start = 0;
+}
+
+void stats_sums_feed(stats_sums_t *s, uint16_t x, uint32_t at) {
+    if (s->n++ == 0) s->start = at;
+    s->sum += x;
+    s->sumsq += (uint32_t)x * x;
+    if (x < s->min) { s->min = x; s->min_at = at; }
+    if (x > s->max) { s->max = x; s->max_at = at; }
+}
+
+void stats_window_reset(stats_window_t *w) {
+    w->pos = 0;
+    w->sum = 0;
+    w->sumsq = 0;
+    w->min_head = w->min_tail = 0;
+    w->max_head = w->max_tail = 0;
+}
+
+/**
+ * The queues hold positions in the window whose values are strictly
+ * increasing (min) or decreasing (max) from head to tail, so the head is
+ * the window's extreme. A new sample drops the candidates it beats from
+ * the tail; the head drops out when its position leaves the window.
+ */
+void stats_window_feed(stats_window_t *w, uint16_t x) {
+    uint32_t p = w->pos++;
+    
+    if (p >= STATS_WINDOW) {
+        uint16_t old = w->ring[p & WINDOW_MASK];
+        w->sum -= old;
+        w->sumsq -= (uint32_t)old * old;
+        if (w->minq[w->min_head & WINDOW_MASK] == p - STATS_WINDOW) w->min_head++;
+        if (w->maxq[w->max_head & WINDOW_MASK] == p - STATS_WINDOW) w->max_head++;
+    }
+    w->ring[p & WINDOW_MASK] = x;
+    w->sum += x;
+    w->sumsq += (uint32_t)x * x;
+    
+    while (w->min_tail != w->min_head &&
+           w->ring[w->minq[(w->min_tail - 1) & WINDOW_MASK] & WINDOW_MASK] >= x) {
+        w->min_tail--;
+    }
+    w->minq[w->min_tail++ & WINDOW_MASK] = p;
+    
+    while (w->max_tail != w->max_head &&
+           w->ring[w->maxq[(w->max_tail - 1) & WINDOW_MASK] & WINDOW_MASK] <= x) {
+        w->max_tail--;
+    }
+    w->maxq[w->max_tail++ & WINDOW_MASK] = p;
+}
+
+/**
+ * Snapshot of the window as sums, positions counted from the reset
+ */
+void stats_window_sums(const stats_window_t *w, stats_sums_t *s) {
+    if (w->pos == 0) {
+        stats_sums_reset(s);
+        return;
+    }
+    s->n = w->pos < STATS_WINDOW ? w->pos : STATS_WINDOW;
+    s->sum = w->sum;
+    s->sumsq = w->sumsq;
+    s->min_at = w->minq[w->min_head & WINDOW_MASK];
+    s->max_at = w->maxq[w->max_head & WINDOW_MASK];
+    s->min = w->ring[s->min_at & WINDOW_MASK];
+    s->max = w->ring[s->max_at & WINDOW_MASK];
+    s->start = w->pos - s->n;
+}
+
+static int32_t q8_to_uv(int64_t q8) {
+    return (int32_t)((q8 * AD7705_UV_PER_LSB_Q16) >> 24);
+}
+
+// Mean of x, codes Q8
+static uint64_t mean_q8(const stats_sums_t *s) {
+    return (s->sum << 8) / s->n;
+}
+
+// Mean of x^2, codes^2 Q16
+static uint64_t mean_square_q16(const stats_sums_t *s) {
+    return ((s->sumsq / s->n) << 16) + ((s->sumsq % s->n) << 16) / s->n;
+}
+
+// Mean of (x - zero)^2 = mean of x^2 - 2 zero mean + zero^2, codes^2 Q16
+static uint64_t mean_square_about_q16(const stats_sums_t *s, uint16_t zero) {
+    uint64_t msq = mean_square_q16(s) + ((uint64_t)zero * zero << 16);
+    uint64_t cross = (uint64_t)zero * mean_q8(s) << 9;
+    return msq > cross ? msq - cross : 0;
+}
+
+// Variance about the mean, codes^2 Q16
+static uint64_t variance_q16(const stats_sums_t *s) {
+    uint64_t m = mean_q8(s);
+    uint64_t msq = mean_square_q16(s);
+    return msq > m * m ? msq - m * m : 0;
+}
+
+int32_t stats_value(const stats_sums_t *s, int measurement) {
+    return stats_value_about(s, measurement, 0);
+}
+
+/**
+ * A measurement of samples whose zero is the code zero rather than code
+ * 0: the mean and RMS are taken about it, the rest do not depend on it
+ */
+int32_t stats_value_about(const stats_sums_t *s, int measurement, uint16_t zero) {
+    if (s->n == 0) return 0;
+    
+    switch (measurement) {
+    case STATS_VPP:
+        return ad7705_raw_to_uv(s->max) - ad7705_raw_to_uv(s->min);
+    case STATS_MEAN:
+        return q8_to_uv((int64_t)mean_q8(s) - ((int64_t)zero << 8));
+    case STATS_RMS:
+        return q8_to_uv(fixed_isqrt64(mean_square_about_q16(s, zero)));
+    case STATS_AC_RMS:
+        return q8_to_uv(fixed_isqrt64(variance_q16(s)));
+    case STATS_STD_DEV:
+        if (s->n < 2) return 0;
+        // Bessel's correction, var * n / (n - 1) without the overflow
+        return q8_to_uv(fixed_isqrt64(variance_q16(s) + variance_q16(s) / (s->n - 1)));
+    default:
+        return 0;
+    }
+}
+
+void stats_compute(const stats_sums_t *s, stats_result_t *r) {
+    r->samples = s->n;
+    r->vpp_uv = stats_value(s, STATS_VPP);
+    r->mean_uv = stats_value(s, STATS_MEAN);
+    r->rms_uv = stats_value(s, STATS_RMS);
+    r->ac_rms_uv = stats_value(s, STATS_AC_RMS);
+    r->std_dev_uv = stats_value(s, STATS_STD_DEV);
+    r->min_uv = s->n ? ad7705_raw_to_uv(s->min) : 0;
+    r->max_uv = s->n ? ad7705_raw_to_uv(s->max) : 0;
+    r->min_at = s->min_at;
+    r->max_at = s->max_at;
+}
@@ -0,0 +1,71 @@
+/**
+ * stats.h - Incremental voltage statistics
+ *
+ * Measurements come from running sums of x and x^2 in 64-bit integers,
+ * plus the min and max with the sample position where each was seen.
+ * Feeding a sample is O(1) and nothing is rescanned to read a result.
+ *
+ * stats_sums_t accumulates from its last reset, e.g. over one sweep.
+ * stats_window_t covers the last STATS_WINDOW samples: the sample leaving
+ * the window is subtracted from the sums, and the min and max come from
+ * monotonic queues of candidate positions, amortised O(1) per sample.
+ *
+ * stats_value() computes one measurement, so the display only pays for
+ * the one it shows; stats_compute() fills in all of them.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+// Sliding window length in samples, a power of two (~1 s at 500 S/s)
+#define STATS_WINDOW        512
+
+// Measurements, for stats_value()
+#define STATS_VPP           0
+#define STATS_MEAN          1
+#define STATS_RMS           2
+#define STATS_AC_RMS        3   // RMS about the mean
+#define STATS_STD_DEV       4   // Sample standard deviation, n - 1
+#define STATS_COUNT         5
+
+typedef struct {
+    uint32_t n;
+    uint64_t sum;               // Sum of raw codes
+    uint64_t sumsq;             // Sum of squared raw codes
+    uint16_t min, max;
+    uint32_t min_at, max_at;    // Positions of the min and max
+    uint32_t start;             // Position of the first sample
+} stats_sums_t;
+
+typedef struct {
+    uint16_t ring[STATS_WINDOW];
+    uint32_t pos;               // Samples fed, the next position
+    uint64_t sum, sumsq;
+    uint32_t minq[STATS_WINDOW], maxq[STATS_WINDOW];
+    uint32_t min_head, min_tail, max_head, max_tail;
+} stats_window_t;
+
+// All measurements in microvolts
+typedef struct {
+    uint32_t samples;
+    int32_t vpp_uv;
+    int32_t mean_uv;
+    int32_t rms_uv;
+    int32_t ac_rms_uv;
+    int32_t std_dev_uv;
+    int32_t min_uv, max_uv;
+    uint32_t min_at, max_at;
+} stats_result_t;
+
+void stats_sums_reset(stats_sums_t *s);
+void stats_sums_feed(stats_sums_t *s, uint16_t x, uint32_t at);
+void stats_window_reset(stats_window_t *w);
+void stats_window_feed(stats_window_t *w, uint16_t x);
+void stats_window_sums(const stats_window_t *w, stats_sums_t *s);
+int32_t stats_value(const stats_sums_t *s, int measurement);
+int32_t stats_value_about(const stats_sums_t *s, int measurement, uint16_t zero);
+void stats_compute(const stats_sums_t *s, stats_result_t *r);
+
+#endif // STATS_H
@@ -0,0 +1,89 @@
+/**
+ * sweep.c - Per-column accumulation across trigger sweeps
+ *
+ * Arrays are indexed by screen column like the waveform buffers in
+ * main.c. A column with min > max held no samples in that sweep and is
+ * left out of the accumulators; each column's own sweep count keeps its
+ * average right while the capture is still filling.
+ */
+
+#include "sweep.h"
+
+static uint32_t sums[SWEEP_COLUMNS];        // Running sum per column
+static uint8_t counts[SWEEP_COLUMNS];       // Sweeps in sums, up to SWEEP_AVERAGE
+static uint16_t env_min[SWEEP_COLUMNS];
+static uint16_t env_max[SWEEP_COLUMNS];
+static uint32_t sweeps;
+
+void sweep_reset(void) {
+    for (int x = 0; x < SWEEP_COLUMNS; x++) {
+        sums[x] = 0;
+        counts[x] = 0;
+        env_min[x] = 0xFFFF;
+        env_max[x] = 0;
+    }
+    sweeps = 0;
+}
+
+/**
+ * Add one sweep to the average. Each column contributes the midpoint of
+ * its min and max, which is its mean for a capture_view_mean() column.
+ */
+void sweep_add_average(const uint16_t *mins, const uint16_t *maxs, int x_first, int x_last) {
+    for (int x = x_first; x <= x_last; x++) {
+        if (mins[x] > maxs[x]) continue;
+        uint32_t v = ((uint32_t)mins[x] + maxs[x] + 1) >> 1;
+        if (counts[x] < SWEEP_AVERAGE) {
+            sums[x] += v;
+            counts[x]++;
+        } else {
+            // The share replaced is rounded, not truncated, or the sum
+            // would creep up to a code above the average
+            sums[x] += v - ((sums[x] + SWEEP_AVERAGE / 2) >> SWEEP_AVERAGE_LOG2);
+        }
+    }
+    sweeps++;
+}
+
+/**
+ * Widen the envelope by one sweep's min/max pairs
+ */
+void sweep_add_envelope(const uint16_t *mins, const uint16_t *maxs, int x_first, int x_last) {
+    for (int x = x_first; x <= x_last; x++) {
+        if (mins[x] > maxs[x]) continue;
+        if (mins[x] < env_min[x]) env_min[x] = mins[x];
+        if (maxs[x] > env_max[x]) env_max[x] = maxs[x];
+    }
+    sweeps++;
+}
+
+/**
+ * Averaged trace as min == max pairs, min > max where no sweep had samples
+ */
+void sweep_get_average(uint16_t *mins, uint16_t *maxs, int x_first, int x_last) {
+    for (int x = x_first; x <= x_last; x++) {
+        uint32_t n = counts[x];
+        if (n == 0) {
+            mins[x] = 0xFFFF;
+            maxs[x] = 0;
+        } else if (n == SWEEP_AVERAGE) {
+            mins[x] = maxs[x] = (uint16_t)((sums[x] + SWEEP_AVERAGE / 2) >> SWEEP_AVERAGE_LOG2);
+        } else {
+            mins[x] = maxs[x] = (uint16_t)((sums[x] + n / 2) / n);
+        }
+    }
+}
+
+void sweep_get_envelope(uint16_t *mins, uint16_t *maxs, int x_first, int x_last) {
+    for (int x = x_first; x <= x_last; x++) {
+        mins[x] = env_min[x];
+        maxs[x] = env_max[x];
+    }
+}
+
+/**
+ * Sweeps added since the reset
+ */
+uint32_t sweep_count(void) {
+    return sweeps;
+}
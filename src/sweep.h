@@ -0,0 +1,31 @@
+/**
+ * sweep.h - Per-column accumulation across trigger sweeps
+ *
+ * Each trigger record is reduced to one value or min/max pair per screen
+ * column, so column c of every sweep lies at the same offset from its
+ * trigger point. Averaging keeps a running sum per column and envelope
+ * mode a running min and max, each updated once per column per sweep:
+ * a sample costs O(1) and nothing is rescanned when a frame is drawn.
+ *
+ * Averaging is exponential once SWEEP_AVERAGE sweeps are in: every new
+ * sweep replaces 1/SWEEP_AVERAGE of the sum. Before that it is the plain
+ * mean of the sweeps so far, so the trace settles without a ramp.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+
+#define SWEEP_AVERAGE_LOG2  4
+#define SWEEP_AVERAGE       (1 << SWEEP_AVERAGE_LOG2)   // Sweeps averaged
+#define SWEEP_COLUMNS       320                         // Screen columns
+
+void sweep_reset(void);
+void sweep_add_average(const uint16_t *mins, const uint16_t *maxs, int x_first, int x_last);
+void sweep_add_envelope(const uint16_t *mins, const uint16_t *maxs, int x_first, int x_last);
+void sweep_get_average(uint16_t *mins, uint16_t *maxs, int x_first, int x_last);
+void sweep_get_envelope(uint16_t *mins, uint16_t *maxs, int x_first, int x_last);
+uint32_t sweep_count(void);
+
+#endif // SWEEP_H
@@ -8,14 +8,14 @@
 
 
 
-// --- Timer Memory-Mapped Register Pointers ---
+// --- Timer Memory-Mapped Register Addresses ---
 // Base address for the timer hardware
 #define TIMER_BASE_ADDR      0x04000020
-// Pointers to the status, control, and period registers
-#define TIMER_STATUS    ((volatile int *)(TIMER_BASE_ADDR + 0x0))
-#define TIMER_CTRL      ((volatile int *)(TIMER_BASE_ADDR + 0x4))
-#define TIMER_PERIODL   ((volatile int *)(TIMER_BASE_ADDR + 0x8))
-#define TIMER_PERIODH   ((volatile int *)(TIMER_BASE_ADDR + 0xC))
+// Status, control, and period registers (accessed through hal_read32/hal_write32)
+#define TIMER_STATUS    (TIMER_BASE_ADDR + 0x0)
+#define TIMER_CTRL      (TIMER_BASE_ADDR + 0x4)
+#define TIMER_PERIODL   (TIMER_BASE_ADDR + 0x8)
+#define TIMER_PERIODH   (TIMER_BASE_ADDR + 0xC)
 
 // --- Timer Control Register Bits ---
 #define TIMER_CTRL_ITO     0x1 // Bit 0: Enable Interrupt
@@ -26,8 +26,12 @@
 // --- Timer Status Register Bits ---
 #define TIMER_STATUS_TO    0x1 // Bit 0: Timeout Flag (Clear this in the ISR)
 
+// Interrupt cause passed to handle_interrupt() for a timer timeout
+#define TIMER_IRQ          16
+
 
 void timer_init(int frequency_hz);
+void timer_enable_interrupt(void);
 bool timer_check_tick();
 
 
@@ -0,0 +1,143 @@
+/**
+ * trigger.c - Streaming edge trigger with pre-trigger capture
+ *
+ * The edge detector uses a hysteresis band below the level (rising) or
+ * above it (falling): the detector only arms once the signal has been on
+ * the far side of the band, so noise riding on a slow crossing cannot
+ * fire it twice. Sample counts are free-running 32-bit counters; all
+ * comparisons are by subtraction, so they survive wrap-around.
+ */
+
+#include "trigger.h"
+
+static trigger_config_t cfg;
+
+static uint32_t count;          // Samples fed so far
+static uint32_t trig_at;        // Sample number of the last trigger point
+static uint32_t record_end;     // Sample number that completes the record
+static uint32_t waiting;        // Samples spent armed since the last record
+static uint8_t state;
+static uint8_t edge_armed;      // Signal has been on the far side of the band
+static uint8_t forced;          // Last record was forced by auto mode
+static uint8_t have_trigger;    // trig_at is valid (holdoff applies)
+
+/**
+ * Configure and arm. record_len is clamped to TRIG_RECORD_MAX and
+ * pre_samples to record_len - 1, so the trigger point is always in the
+ * record.
+ */
+void trigger_init(const trigger_config_t *config) {
+    cfg = *config;
+    if (cfg.record_len == 0 || cfg.record_len > TRIG_RECORD_MAX) {
+        cfg.record_len = TRIG_RECORD_MAX;
+    }
+    if (cfg.pre_samples >= cfg.record_len) {
+        cfg.pre_samples = cfg.record_len - 1;
+    }
+    
+    count = 0;
+    have_trigger = 0;
+    forced = 0;
+    edge_armed = 0;
+    trigger_arm();
+}
+
+/**
+ * Wait for the next trigger; needed after a single record
+ */
+void trigger_arm(void) {
+    state = TRIG_STATE_READY;
+    waiting = 0;
+}
+
+/**
+ * One step of the hysteresis edge detector. Returns 1 on the sample
+ * that crosses the level in the selected direction.
+ */
+static inline int edge_detect(uint16_t s) {
+    int32_t level = cfg.level;
+    int32_t band = cfg.hysteresis;
+    
+    if (cfg.edge == TRIG_EDGE_RISING) {
+        if ((int32_t)s <= level - band) edge_armed = 1;
+        if (edge_armed && s >= level) {
+            edge_armed = 0;
+            return 1;
+        }
+    } else {
+        if ((int32_t)s >= level + band) edge_armed = 1;
+        if (edge_armed && s <= level) {
+            edge_armed = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void fire(uint32_t at, uint8_t is_forced) {
+    trig_at = at;
+    have_trigger = 1;
+    forced = is_forced;
+    record_end = at - cfg.pre_samples + cfg.record_len;
+    state = TRIG_STATE_CAPTURE;
+}
+
+/**
+ * Finish the record once the sample completing it is in. With the
+ * trigger point last in the record that is the trigger sample itself, so
+ * this also runs on the sample that fires.
+ */
+static int complete(void) {
+    if ((int32_t)(count - record_end) < 0) return 0;
+    state = (cfg.mode == TRIG_MODE_SINGLE) ? TRIG_STATE_STOPPED : TRIG_STATE_READY;
+    waiting = 0;
+    return 1;
+}
+
+/**
+ * Feed one sample. Returns 1 when it completes a record: the record is
+ * the last record_len samples fed, this one included.
+ */
+int trigger_feed(uint16_t sample) {
+    uint32_t n = count++;
+    int hit = edge_detect(sample);
+    
+    switch (state) {
+    case TRIG_STATE_READY:
+        // A full pre-trigger window must exist before the trigger point
+        if (count <= cfg.pre_samples) break;
+        waiting++;
+        if (hit && (!have_trigger || n - trig_at >= cfg.holdoff)) {
+            fire(n, 0);
+        } else if (cfg.mode == TRIG_MODE_AUTO && waiting >= cfg.auto_timeout) {
+            fire(n, 1);
+        } else {
+            break;
+        }
+        return complete();
+        
+    case TRIG_STATE_CAPTURE:
+        return complete();
+        
+    default:
+        break;
+    }
+    return 0;
+}
+
+uint8_t trigger_state(void) {
+    return state;
+}
+
+/**
+ * Trigger indicator for the display. "Ready" once the trigger has been
+ * armed for a full record length without an edge, otherwise what
+ * produced the last record.
+ */
+uint8_t trigger_status(void) {
+    if (state == TRIG_STATE_READY && waiting >= cfg.record_len) {
+        return TRIG_STATUS_READY;
+    }
+    if (!have_trigger) return TRIG_STATUS_READY;
+    return forced ? TRIG_STATUS_AUTO : TRIG_STATUS_TRIGD;
+}
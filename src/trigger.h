@@ -0,0 +1,57 @@
+/**
+ * trigger.h - Streaming edge trigger with pre-trigger capture
+ *
+ * Every sample from the acquisition ring goes through trigger_feed(),
+ * which does a constant amount of work: update the hysteresis edge
+ * detector and step the state machine. The trigger keeps no samples;
+ * when a record completes, it is the last record_len samples fed, which
+ * the caller reads from the capture.
+ *
+ * A record is record_len samples with the trigger point pre_samples in.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdint.h>
+
+// Longest record, a screen width
+#define TRIG_RECORD_MAX     320
+
+// Edge
+#define TRIG_EDGE_RISING    0
+#define TRIG_EDGE_FALLING   1
+
+// Sweep mode
+#define TRIG_MODE_AUTO      0   // Force a record if no trigger arrives in time
+#define TRIG_MODE_NORMAL    1   // Only triggered records, re-arm after each
+#define TRIG_MODE_SINGLE    2   // One triggered record, then stop until re-armed
+
+// State machine
+#define TRIG_STATE_READY    0   // Armed, waiting for an edge
+#define TRIG_STATE_CAPTURE  1   // Triggered, collecting post-trigger samples
+#define TRIG_STATE_STOPPED  2   // Single record taken
+
+// What the display should say about the last record
+#define TRIG_STATUS_READY   0   // Armed, no trigger for a while
+#define TRIG_STATUS_TRIGD   1   // Last record came from a real edge
+#define TRIG_STATUS_AUTO    2   // Last record was forced by auto mode
+
+typedef struct {
+    uint16_t level;             // Trigger level, raw ADC code
+    uint16_t hysteresis;        // Signal must go this far past level the other way to re-arm
+    uint8_t edge;               // TRIG_EDGE_*
+    uint8_t mode;               // TRIG_MODE_*
+    uint16_t record_len;        // Samples per record, at most TRIG_RECORD_MAX
+    uint16_t pre_samples;       // Samples kept before the trigger point, < record_len
+    uint32_t holdoff;           // Minimum samples between trigger points
+    uint32_t auto_timeout;      // Samples without a trigger before auto forces one
+} trigger_config_t;
+
+void trigger_init(const trigger_config_t *config);
+void trigger_arm(void);
+int trigger_feed(uint16_t sample);
+uint8_t trigger_state(void);
+uint8_t trigger_status(void);
+
+#endif // TRIGGER_H
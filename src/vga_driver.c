@@ -11,6 +11,10 @@
  */
 
 #include "vga_driver.h"
+#include "hal.h"
+#include "delay.h"
+#include "fixed.h"
+#include "trigger.h"
 #include <stdint.h>
 
 // ============================================================================
@@ -23,9 +27,13 @@
 #define GRID_W          320
 #define GRID_H          (240 - TOP_BAR_H - BOTTOM_BAR_H)  // 200px
 
+#if VGA_WAVEFORM_WIDTH != GRID_W - 2 || VGA_WAVEFORM_HEIGHT != GRID_H - 2
+#error "VGA_WAVEFORM_WIDTH/HEIGHT do not match the grid layout"
+#endif
+
 // Grid divisions: 10 horizontal, 8 vertical (standard scope)
-#define DIV_X           10
-#define DIV_Y           8
+#define DIV_X           VGA_GRID_DIV_X
+#define DIV_Y           VGA_GRID_DIV_Y
 
 
 
@@ -131,39 +139,300 @@ static const uint8_t font[91][5] = {
 // ============================================================================
 static struct {
     int running;           // 1=Run, 0=Stop
-    int triggered;         // 1=Trig'd, 0=waiting
-    float ch1_vdiv;        // V/div for CH1
-    float ch2_vdiv;        // V/div for CH2
-    float time_div;        // Time/div in ms
-    float ch1_pkpk;        // CH1 peak-to-peak
-    float ch2_pkpk;        // CH2 peak-to-peak
+    int source;            // VGA_SOURCE_*
+    int replay_speed;      // Times real time
+    int acquire;           // VGA_ACQ_*
+    int avg_sweeps;        // Sweeps averaged in VGA_ACQ_AVERAGE
+    int fft_points;        // Spectrum display: FFT size, 0 = time domain
+    const char *fft_window; // Its window name
+    int32_t fft_mhz_div;   // Its horizontal scale, mHz/div
+    const char *filter;    // CH1 filter name, "" = none
+    int triggered;         // TRIG_STATUS_*
+    uint16_t trig_level;   // Trigger level, raw ADC code
+    int32_t ch1_vdiv_mv;   // mV/div for CH1
+    int32_t ch2_vdiv_mv;   // mV/div for CH2
+    int32_t time_div_us;   // Time/div in us
+    int32_t ch1_meas_uv;   // CH1 footer measurement in uV
+    int32_t ch2_meas_uv;   // CH2 footer measurement in uV
+    int32_t math_meas_uv;  // Math trace footer measurement in uV
+    const char *math;      // Math function name, "" = none
+    int32_t math_vdiv_mv;  // Math trace V/div in mV, 0 = not in volts
+    int xy;                // XY display instead of the timebase
+    int xy_trail;          // Its trail in points, 0 = infinite persistence
+    const char *meas_label; // Its label, up to 3 characters
+    int32_t freq_mhz;      // CH1 frequency in mHz, 0 = no signal
+    int32_t duty_permille; // CH1 duty cycle, 0-1000
     int ch1_enabled;       // CH1 on/off
     int ch2_enabled;       // CH2 on/off
 } scope = {
     .running = 1,
-    .triggered = 0,
-    .ch1_vdiv = 0.5f,
-    .ch2_vdiv = 1.0f,
-    .time_div = 5.0f,
-    .ch1_pkpk = 0.0f,
-    .ch2_pkpk = 0.0f,
+    .source = VGA_SOURCE_LIVE,
+    .replay_speed = 1,
+    .acquire = VGA_ACQ_NORMAL,
+    .avg_sweeps = 1,
+    .fft_points = 0,
+    .fft_window = "",
+    .fft_mhz_div = 0,
+    .filter = "",
+    .math = "",
+    .triggered = TRIG_STATUS_READY,
+    .trig_level = 32768,
+    .ch1_vdiv_mv = 500,
+    .ch2_vdiv_mv = 1000,
+    .time_div_us = 5000,
+    .ch1_meas_uv = 0,
+    .ch2_meas_uv = 0,
+    .meas_label = "Pk:",
+    .freq_mhz = 0,
+    .duty_permille = 0,
     .ch1_enabled = 1,
     .ch2_enabled = 0
 };
 
+// ============================================================================
+// Render Target
+// ============================================================================
+
+// Frame index (0 or 1) that drawing and flushes land in. In incremental
+// mode it is the visible frame, in double-buffered mode the back buffer.
+static int draw_frame = 0;
+static uint8_t render_mode = VGA_MODE_INCREMENTAL;
+
+static inline uint32_t frame_addr(int frame) {
+    return VGA_PIXEL_BUFFER_BASE + frame * VGA_FRAME_BYTES;
+}
+
+// ============================================================================
+// Shadow Framebuffer
+// ============================================================================
+#if VGA_SHADOW_FRAMEBUFFER
+
+// Drawing lands here; the word view lets vga_flush() store two pixels at once
+static union {
+    uint16_t px[SCREEN_WIDTH * SCREEN_HEIGHT];
+    uint32_t words[SCREEN_WIDTH * SCREEN_HEIGHT / 2];
+} shadow;
+
+// Dirty span per row (inclusive), x0 > x1 means the row is clean. top and
+// bottom bound the rows that may be dirty so a flush does not scan them all.
+typedef struct {
+    int16_t x0[SCREEN_HEIGHT];
+    int16_t x1[SCREEN_HEIGHT];
+    int top, bottom;
+} dirty_map_t;
+
+#define DIRTY_MAP_CLEAN { \
+    .x0 = { [0 ... SCREEN_HEIGHT - 1] = SCREEN_WIDTH }, \
+    .x1 = { [0 ... SCREEN_HEIGHT - 1] = -1 }, \
+    .top = SCREEN_HEIGHT, .bottom = -1 }
+
+// Pixels changed since the last flush
+static dirty_map_t dirty = DIRTY_MAP_CLEAN;
+
+// Spans each VGA frame still lacks from earlier flushes into the other one
+static dirty_map_t owed[2] = { DIRTY_MAP_CLEAN, DIRTY_MAP_CLEAN };
+
+static uint32_t flush_words;
+
+static inline void dirty_merge(dirty_map_t *m, int y, int x0, int x1) {
+    if (x0 < m->x0[y]) m->x0[y] = x0;
+    if (x1 > m->x1[y]) m->x1[y] = x1;
+    if (y < m->top) m->top = y;
+    if (y > m->bottom) m->bottom = y;
+}
+
+static void dirty_fill(dirty_map_t *m) {
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        m->x0[y] = 0;
+        m->x1[y] = SCREEN_WIDTH - 1;
+    }
+    m->top = 0;
+    m->bottom = SCREEN_HEIGHT - 1;
+}
+
+/**
+ * Unchecked store into the shadow. Only pixels that actually change are
+ * marked dirty, so redrawing unchanged grid or background costs nothing
+ * at flush time.
+ */
+static inline void put_pixel(int x, int y, uint16_t c) {
+    uint16_t *p = &shadow.px[y * SCREEN_WIDTH + x];
+    if (*p == c) return;
+    *p = c;
+    dirty_merge(&dirty, y, x, x);
+}
+
+/**
+ * Mark the whole screen dirty in both frames, for when VGA memory no
+ * longer matches the shadow (at boot, the pixel buffer holds whatever
+ * was there before)
+ */
+void vga_invalidate(void) {
+    dirty_fill(&dirty);
+    dirty_fill(&owed[0]);
+    dirty_fill(&owed[1]);
+}
+
+/**
+ * Copy the dirty spans to the draw frame with 32-bit stores. Spans are
+ * widened to whole pixel pairs; rows start word aligned because
+ * SCREEN_WIDTH is even.
+ *
+ * The draw frame also receives what it missed while the other frame was
+ * being drawn, so in double-buffered mode each back buffer catches up on
+ * two frames' worth of changes.
+ */
+void vga_flush(void) {
+    uint32_t base = frame_addr(draw_frame);
+    dirty_map_t *mine = &owed[draw_frame];
+    dirty_map_t *other = &owed[draw_frame ^ 1];
+    
+    int top = dirty.top < mine->top ? dirty.top : mine->top;
+    int bottom = dirty.bottom > mine->bottom ? dirty.bottom : mine->bottom;
+    
+    for (int y = top; y <= bottom; y++) {
+        int x0 = dirty.x0[y], x1 = dirty.x1[y];
+        if (x0 <= x1) dirty_merge(other, y, x0, x1);
+        if (mine->x0[y] < x0) x0 = mine->x0[y];
+        if (mine->x1[y] > x1) x1 = mine->x1[y];
+        if (x0 > x1) continue;
+        
+        int w0 = (y * SCREEN_WIDTH + x0) >> 1;
+        int w1 = (y * SCREEN_WIDTH + x1) >> 1;
+        for (int w = w0; w <= w1; w++) {
+            hal_write32(base + w * 4, shadow.words[w]);
+        }
+        flush_words += w1 - w0 + 1;
+        
+        dirty.x0[y] = mine->x0[y] = SCREEN_WIDTH;
+        dirty.x1[y] = mine->x1[y] = -1;
+    }
+    dirty.top = mine->top = SCREEN_HEIGHT;
+    dirty.bottom = mine->bottom = -1;
+}
+
+#else
+
+static inline void put_pixel(int x, int y, uint16_t c) {
+    hal_write16(frame_addr(draw_frame) + (y * SCREEN_WIDTH + x) * 2, c);
+}
+
+static uint32_t flush_words;
+
+void vga_invalidate(void) {
+}
+
+void vga_flush(void) {
+}
+
+#endif // VGA_SHADOW_FRAMEBUFFER
+
+/**
+ * 32-bit words copied to VGA memory by vga_flush() since boot
+ */
+uint32_t vga_get_flush_words(void) {
+    return flush_words;
+}
+
+// ============================================================================
+// Double Buffering
+// ============================================================================
+
+static vga_frame_stats_t frame_stats;
+static uint32_t compose_start;
+static uint32_t swap_requested;
+static int swap_outstanding;
+
+/**
+ * Select incremental or double-buffered rendering. The frame on screen
+ * stays on screen; in double-buffered mode drawing moves to the other one.
+ */
+void vga_set_render_mode(uint8_t mode) {
+    while (vga_swap_pending()) {
+    }
+    
+    int front = hal_read32(VGA_DMA_BUFFER) == frame_addr(1) ? 1 : 0;
+    render_mode = mode;
+    draw_frame = (mode == VGA_MODE_DOUBLE_BUFFER) ? front ^ 1 : front;
+    vga_invalidate();
+}
+
+uint8_t vga_get_render_mode(void) {
+    return render_mode;
+}
+
+/**
+ * True while a requested swap is waiting for the end of the frame being
+ * scanned out. The swap latency is recorded when it is first seen done.
+ */
+int vga_swap_pending(void) {
+    if (!swap_outstanding) return 0;
+    if (hal_read32(VGA_DMA_STATUS) & VGA_DMA_STATUS_SWAP) return 1;
+    
+    uint32_t latency = cycles_now() - swap_requested;
+    frame_stats.swap_cycles += latency;
+    if (latency > frame_stats.swap_max) frame_stats.swap_max = latency;
+    swap_outstanding = 0;
+    return 0;
+}
+
+/**
+ * Start composing a frame. Blocks until the previous swap is done, since
+ * until then the draw frame is still the one being displayed.
+ */
+void vga_begin_frame(void) {
+    while (vga_swap_pending()) {
+    }
+    compose_start = cycles_now();
+}
+
+/**
+ * Finish a frame. In double-buffered mode the back buffer is brought up
+ * to date and a swap requested for the next vsync; drawing then moves to
+ * the frame being replaced. In incremental mode this is just a flush.
+ */
+void vga_present(void) {
+    vga_flush();
+    if (render_mode != VGA_MODE_DOUBLE_BUFFER) return;
+    
+    uint32_t now = cycles_now();
+    uint32_t compose = now - compose_start;
+    frame_stats.compose_cycles += compose;
+    if (compose > frame_stats.compose_max) frame_stats.compose_max = compose;
+    frame_stats.frames++;
+    
+    hal_write32(VGA_DMA_BACK_BUFFER, frame_addr(draw_frame));
+    hal_write32(VGA_DMA_BUFFER, 1);
+    swap_requested = now;
+    swap_outstanding = 1;
+    draw_frame ^= 1;
+}
+
+void vga_get_frame_stats(vga_frame_stats_t *stats) {
+    *stats = frame_stats;
+}
+
+void vga_reset_frame_stats(void) {
+    vga_frame_stats_t zero = {0};
+    frame_stats = zero;
+}
+
 // ============================================================================
 // Basic Drawing
 // ============================================================================
 
 void vga_clear_screen(uint16_t color) {
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        pVGA_PIXEL_BUFFER[i] = color;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            put_pixel(x, y, color);
+        }
     }
+    vga_invalidate();
 }
 
 void vga_draw_pixel(int x, int y, uint16_t color) {
     if (x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT) {
-        pVGA_PIXEL_BUFFER[y * SCREEN_WIDTH + x] = color;
+        put_pixel(x, y, color);
     }
 }
 
@@ -173,7 +442,7 @@ static void hline(int x1, int x2, int y, uint16_t c) {
     if (x1 < 0) x1 = 0;
     if (x2 >= SCREEN_WIDTH) x2 = SCREEN_WIDTH - 1;
     for (int x = x1; x <= x2; x++) {
-        pVGA_PIXEL_BUFFER[y * SCREEN_WIDTH + x] = c;
+        put_pixel(x, y, c);
     }
 }
 
@@ -183,7 +452,7 @@ static void vline(int x, int y1, int y2, uint16_t c) {
     if (y1 < 0) y1 = 0;
     if (y2 >= SCREEN_HEIGHT) y2 = SCREEN_HEIGHT - 1;
     for (int y = y1; y <= y2; y++) {
-        pVGA_PIXEL_BUFFER[y * SCREEN_WIDTH + x] = c;
+        put_pixel(x, y, c);
     }
 }
 
@@ -253,54 +522,61 @@ void vga_draw_int(int x, int y, int val, uint16_t color) {
     while (i > 0) { vga_draw_char(x, y, buf[--i], color); x += 6; }
 }
 
-// Draw float: handles 0-999 with 1-2 decimal places
-static void draw_float(int x, int y, float val, int dec, uint16_t color) {
-    if (val < 0) { vga_draw_char(x, y, '-', color); x += 6; val = -val; }
-    
-    int ipart = (int)val;
-    float fpart = val - ipart;
-    
-    // Integer part
-    if (ipart == 0) {
-        vga_draw_char(x, y, '0', color);
-        x += 6;
-    } else {
-        char buf[6];
-        int i = 0;
-        while (ipart > 0) { buf[i++] = '0' + (ipart % 10); ipart /= 10; }
-        while (i > 0) { vga_draw_char(x, y, buf[--i], color); x += 6; }
-    }
-    
-    // Decimal
-    if (dec > 0) {
-        vga_draw_char(x, y, '.', color);
-        x += 6;
-        for (int d = 0; d < dec; d++) {
-            fpart *= 10;
-            int digit = (int)fpart;
-            vga_draw_char(x, y, '0' + digit, color);
-            x += 6;
-            fpart -= digit;
-        }
-    }
+// Draw value / 10^scale with dec decimal places, truncated
+static void draw_fixed(int x, int y, int32_t value, int scale, int dec, uint16_t color) {
+    char buf[FIXED_FORMAT_MAX];
+    fixed_format(buf, value, scale, dec);
+    vga_draw_string(x, y, buf, color);
 }
 
 // ============================================================================
 // Grid Drawing - Clean Tektronix style
 // ============================================================================
 
-void vga_draw_grid(void) {
+// Graticule image of the grid area, rendered once by vga_scope_init().
+// Column-major so restoring a column reads it sequentially; RGB332 fits
+// in a byte per pixel.
+static uint8_t graticule[GRID_W][GRID_H];
+
+static void grat_dot(int x, int y, uint8_t c) {
+    x -= GRID_X;
+    y -= GRID_Y;
+    if (x >= 0 && x < GRID_W && y >= 0 && y < GRID_H) {
+        graticule[x][y] = c;
+    }
+}
+
+static void grat_hline(int x1, int x2, int y, uint8_t c) {
+    for (int x = x1; x <= x2; x++) grat_dot(x, y, c);
+}
+
+static void grat_vline(int x, int y1, int y2, uint8_t c) {
+    for (int y = y1; y <= y2; y++) grat_dot(x, y, c);
+}
+
+/**
+ * Render the grid into the graticule image. Ticks that fall outside the
+ * grid area (the last row and column of major ticks) are dropped; the
+ * footer separator and screen edge cover them anyway.
+ */
+static void build_graticule(void) {
     int div_w = GRID_W / DIV_X;  // 32 pixels
     int div_h = GRID_H / DIV_Y;  // 25 pixels
     int cx = GRID_X + GRID_W / 2;
     int cy = GRID_Y + GRID_H / 2;
     
+    for (int x = 0; x < GRID_W; x++) {
+        for (int y = 0; y < GRID_H; y++) {
+            graticule[x][y] = COLOR_BLACK;
+        }
+    }
+    
     // Draw dotted grid lines
     // Vertical lines
     for (int i = 1; i < DIV_X; i++) {
         int x = GRID_X + i * div_w;
         for (int y = GRID_Y; y < GRID_Y + GRID_H; y += 5) {
-            vga_draw_pixel(x, y, COLOR_GRID);
+            grat_dot(x, y, COLOR_GRID);
         }
     }
     
@@ -308,45 +584,60 @@ void vga_draw_grid(void) {
     for (int i = 1; i < DIV_Y; i++) {
         int y = GRID_Y + i * div_h;
         for (int x = GRID_X; x < GRID_X + GRID_W; x += 5) {
-            vga_draw_pixel(x, y, COLOR_GRID);
+            grat_dot(x, y, COLOR_GRID);
         }
     }
     
     // Center crosshair - denser dots
     for (int x = GRID_X; x < GRID_X + GRID_W; x += 3) {
-        vga_draw_pixel(x, cy, COLOR_GRID_BRIGHT);
+        grat_dot(x, cy, COLOR_GRID_BRIGHT);
     }
     for (int y = GRID_Y; y < GRID_Y + GRID_H; y += 3) {
-        vga_draw_pixel(cx, y, COLOR_GRID_BRIGHT);
+        grat_dot(cx, y, COLOR_GRID_BRIGHT);
     }
     
     // Tick marks on center lines
     for (int i = 0; i <= DIV_X; i++) {
         int x = GRID_X + i * div_w;
         // Major tick
-        vline(x, cy - 3, cy + 3, COLOR_GRID_BRIGHT);
+        grat_vline(x, cy - 3, cy + 3, COLOR_GRID_BRIGHT);
         // Minor ticks (5 per div)
         if (i < DIV_X) {
             int step = div_w / 5;
             for (int m = 1; m < 5; m++) {
-                vline(x + m * step, cy - 1, cy + 1, COLOR_GRID_BRIGHT);
+                grat_vline(x + m * step, cy - 1, cy + 1, COLOR_GRID_BRIGHT);
             }
         }
     }
     
     for (int i = 0; i <= DIV_Y; i++) {
         int y = GRID_Y + i * div_h;
-        hline(cx - 3, cx + 3, y, COLOR_GRID_BRIGHT);
+        grat_hline(cx - 3, cx + 3, y, COLOR_GRID_BRIGHT);
         if (i < DIV_Y) {
             int step = div_h / 5;
             for (int m = 1; m < 5; m++) {
-                hline(cx - 1, cx + 1, y + m * step, COLOR_GRID_BRIGHT);
+                grat_hline(cx - 1, cx + 1, y + m * step, COLOR_GRID_BRIGHT);
             }
         }
     }
     
     // Border
-    vga_draw_box_outline(GRID_X, GRID_Y, GRID_W, GRID_H, COLOR_GRID_BRIGHT);
+    grat_hline(GRID_X, GRID_X + GRID_W - 1, GRID_Y, COLOR_GRID_BRIGHT);
+    grat_hline(GRID_X, GRID_X + GRID_W - 1, GRID_Y + GRID_H - 1, COLOR_GRID_BRIGHT);
+    grat_vline(GRID_X, GRID_Y, GRID_Y + GRID_H - 1, COLOR_GRID_BRIGHT);
+    grat_vline(GRID_X + GRID_W - 1, GRID_Y, GRID_Y + GRID_H - 1, COLOR_GRID_BRIGHT);
+}
+
+/**
+ * Paint the whole grid area from the graticule image. This also clears
+ * any trace inside it.
+ */
+void vga_draw_grid(void) {
+    for (int y = 0; y < GRID_H; y++) {
+        for (int x = 0; x < GRID_W; x++) {
+            put_pixel(GRID_X + x, GRID_Y + y, graticule[x][y]);
+        }
+    }
 }
 
 // ============================================================================
@@ -367,9 +658,40 @@ void vga_draw_header(void) {
         vga_draw_string(30, 2, "Stop", COLOR_RED);
     }
     
+    // Recording / replay
+    if (scope.source == VGA_SOURCE_RECORDING) {
+        vga_draw_string(66, 2, "Rec", COLOR_RED);
+    } else if (scope.source == VGA_SOURCE_REPLAY) {
+        vga_draw_string(66, 2, "Play x", COLOR_CYAN);
+        vga_draw_int(102, 2, scope.replay_speed, COLOR_CYAN);
+    }
+    
+    // Spectrum, XY, or the acquisition mode
+    if (scope.xy) {
+        vga_draw_string(126, 2, "XY", COLOR_WHITE);
+        if (scope.xy_trail > 0) vga_draw_int(146, 2, scope.xy_trail, COLOR_WHITE);
+        else vga_draw_string(146, 2, "Pers", COLOR_WHITE);
+    } else if (scope.fft_points > 0) {
+        vga_draw_string(126, 2, "FFT", COLOR_WHITE);
+        vga_draw_int(146, 2, scope.fft_points, COLOR_WHITE);
+        vga_draw_string(176, 2, scope.fft_window, COLOR_WHITE);
+    } else if (scope.acquire == VGA_ACQ_AVERAGE) {
+        vga_draw_string(126, 2, "Avg", COLOR_WHITE);
+        vga_draw_int(146, 2, scope.avg_sweeps, COLOR_WHITE);
+    } else if (scope.acquire == VGA_ACQ_ENVELOPE) {
+        vga_draw_string(126, 2, "Env", COLOR_WHITE);
+    } else if (scope.acquire == VGA_ACQ_HIRES) {
+        vga_draw_string(126, 2, "HiRes", COLOR_WHITE);
+    }
+    
+    // CH1 filter
+    vga_draw_string(206, 2, scope.filter, COLOR_YELLOW);
+    
     // Trigger status
-    if (scope.triggered) {
+    if (scope.triggered == TRIG_STATUS_TRIGD) {
         vga_draw_string(240, 2, "Trig'd", COLOR_GREEN);
+    } else if (scope.triggered == TRIG_STATUS_AUTO) {
+        vga_draw_string(240, 2, "Auto", COLOR_YELLOW);
     } else {
         vga_draw_string(240, 2, "Ready", COLOR_GRAY);
     }
@@ -394,41 +716,75 @@ void vga_draw_footer(void) {
     // Row 1: Channel settings
     int row1 = y + 4;
     
-    // CH1 indicator and V/div
-    vga_draw_string(4, row1, "Ch1", COLOR_YELLOW);
-    draw_float(30, row1, scope.ch1_vdiv, 2, COLOR_YELLOW);
-    vga_draw_string(66, row1, "V", COLOR_YELLOW);
-    
-    // CH2 indicator and V/div  
-    vga_draw_string(90, row1, "Ch2", COLOR_CYAN);
-    draw_float(116, row1, scope.ch2_vdiv, 2, COLOR_CYAN);
-    vga_draw_string(152, row1, "V", COLOR_CYAN);
-    
-    // Time/div
-    vga_draw_string(175, row1, "M", COLOR_WHITE);
-    draw_float(188, row1, scope.time_div, 1, COLOR_WHITE);
-    vga_draw_string(224, row1, "ms", COLOR_WHITE);
+    if (scope.fft_points > 0) {
+        // dB/div and Hz/div of the spectrum
+        vga_draw_string(4, row1, "Ch1", COLOR_YELLOW);
+        vga_draw_int(30, row1, VGA_SPECTRUM_DB_PER_DIV, COLOR_YELLOW);
+        vga_draw_string(44, row1, "dB", COLOR_YELLOW);
+        vga_draw_string(90, row1, "Ch2", COLOR_CYAN);
+        vga_draw_int(116, row1, VGA_SPECTRUM_DB_PER_DIV, COLOR_CYAN);
+        vga_draw_string(130, row1, "dB", COLOR_CYAN);
+        draw_fixed(188, row1, scope.fft_mhz_div, 3, 1, COLOR_WHITE);
+        vga_draw_string(224, row1, "Hz", COLOR_WHITE);
+    } else {
+        // CH1 indicator and V/div
+        vga_draw_string(4, row1, "Ch1", COLOR_YELLOW);
+        draw_fixed(30, row1, scope.ch1_vdiv_mv, 3, 2, COLOR_YELLOW);
+        vga_draw_string(66, row1, "V", COLOR_YELLOW);
+        
+        // CH2 indicator and V/div  
+        vga_draw_string(90, row1, "Ch2", COLOR_CYAN);
+        draw_fixed(116, row1, scope.ch2_vdiv_mv, 3, 2, COLOR_CYAN);
+        vga_draw_string(152, row1, "V", COLOR_CYAN);
+        
+        // Time/div
+        vga_draw_string(175, row1, "M", COLOR_WHITE);
+        draw_fixed(188, row1, scope.time_div_us, 3, 1, COLOR_WHITE);
+        vga_draw_string(224, row1, "ms", COLOR_WHITE);
+    }
     
     // Row 2: Measurements
     int row2 = y + 15;
     
     // CH1 Pk-Pk
-    vga_draw_string(4, row2, "Pk:", COLOR_GRAY);
-    draw_float(28, row2, scope.ch1_pkpk, 2, COLOR_YELLOW);
+    vga_draw_string(4, row2, scope.meas_label, COLOR_GRAY);
+    draw_fixed(28, row2, scope.ch1_meas_uv, 6, 2, COLOR_YELLOW);
     vga_draw_string(70, row2, "V", COLOR_YELLOW);
     
     // CH2 Pk-Pk
     if (scope.ch2_enabled) {
-        vga_draw_string(90, row2, "Pk:", COLOR_GRAY);
-        draw_float(114, row2, scope.ch2_pkpk, 2, COLOR_CYAN);
+        vga_draw_string(90, row2, scope.meas_label, COLOR_GRAY);
+        draw_fixed(114, row2, scope.ch2_meas_uv, 6, 2, COLOR_CYAN);
         vga_draw_string(156, row2, "V", COLOR_CYAN);
     }
     
-    // DC coupling indicator
-    vga_draw_string(260, row1, "DC", COLOR_WHITE);
+    // CH1 frequency and duty cycle
+    vga_draw_string(166, row2, "F", COLOR_GRAY);
+    if (scope.freq_mhz > 0) {
+        draw_fixed(176, row2, scope.freq_mhz, 3, 2, COLOR_YELLOW);
+        vga_draw_string(212, row2, "Hz", COLOR_YELLOW);
+        draw_fixed(230, row2, scope.duty_permille, 1, 0, COLOR_YELLOW);
+        vga_draw_string(248, row2, "%", COLOR_YELLOW);
+    } else {
+        vga_draw_string(176, row2, "---", COLOR_GRAY);
+    }
     
-    // AD7705 indicator
-    vga_draw_string(260, row2, "16bit", COLOR_GRAY);
+    if (scope.math[0]) {
+        // Math function and its measurement
+        vga_draw_string(260, row1, scope.math, COLOR_MATH);
+        if (scope.math_vdiv_mv > 0) {
+            draw_fixed(284, row1, scope.math_vdiv_mv, 3, 2, COLOR_MATH);
+            vga_draw_string(314, row1, "V", COLOR_MATH);
+        }
+        draw_fixed(260, row2, scope.math_meas_uv, 6, 2, COLOR_MATH);
+        vga_draw_string(302, row2, "V", COLOR_MATH);
+    } else {
+        // DC coupling indicator
+        vga_draw_string(260, row1, "DC", COLOR_WHITE);
+        
+        // AD7705 indicator
+        vga_draw_string(260, row2, "16bit", COLOR_GRAY);
+    }
 }
 
 // ============================================================================
@@ -439,74 +795,100 @@ void vga_clear_waveform_area(void) {
     vga_draw_filled_box(GRID_X + 1, GRID_Y + 1, GRID_W - 2, GRID_H - 2, COLOR_BLACK);
 }
 
-void vga_draw_waveform_segment(int x1, uint16_t y1_adc, int x2, uint16_t y2_adc, uint16_t color) {
-    // Map ADC (0-65535) to screen Y
-    int sy1 = GRID_Y + GRID_H - 1 - (int)((uint32_t)y1_adc * (GRID_H - 2) / 65535);
-    int sy2 = GRID_Y + GRID_H - 1 - (int)((uint32_t)y2_adc * (GRID_H - 2) / 65535);
-    
-    // Clamp
-    if (sy1 < GRID_Y + 1) sy1 = GRID_Y + 1;
-    if (sy1 > GRID_Y + GRID_H - 2) sy1 = GRID_Y + GRID_H - 2;
-    if (sy2 < GRID_Y + 1) sy2 = GRID_Y + 1;
-    if (sy2 > GRID_Y + GRID_H - 2) sy2 = GRID_Y + GRID_H - 2;
-    
-    vga_draw_line(x1, sy1, x2, sy2, color);
+// Map ADC (0-65535) to a screen row inside the waveform area
+static inline int adc_to_y(uint16_t adc_value) {
+    int y = GRID_Y + GRID_H - 1 - (int)((uint32_t)adc_value * (GRID_H - 2) / 65535);
+    if (y < GRID_Y + 1) y = GRID_Y + 1;
+    if (y > GRID_Y + GRID_H - 2) y = GRID_Y + GRID_H - 2;
+    return y;
 }
 
-void vga_erase_column(int x) {
-    if (x < GRID_X + 1 || x > GRID_X + GRID_W - 2) return;
-    
-    // Clear column
-    vline(x, GRID_Y + 1, GRID_Y + GRID_H - 2, COLOR_BLACK);
-    
-    // Restore grid
-    int div_w = GRID_W / DIV_X;
-    int div_h = GRID_H / DIV_Y;
-    int cx = GRID_X + GRID_W / 2;
-    int cy = GRID_Y + GRID_H / 2;
-    int col = x - GRID_X;
+/**
+ * Draw a min/max envelope, one pair per screen column, indexed by screen
+ * column. Each column is one vertical span over its own min..max,
+ * reaching over to its left neighbour's span so the envelope stays
+ * connected; a step starts one row past the neighbour, so where min
+ * equals max the trace is one pixel wide. Columns with min > max hold no
+ * samples and stay empty. The column range is clipped once and rows are
+ * clamped by the ADC mapping, so the stores are unchecked.
+ */
+void vga_draw_envelope(const uint16_t *mins, const uint16_t *maxs,
+                       int x_first, int x_last, uint16_t color) {
+    if (x_first < GRID_X + 1) x_first = GRID_X + 1;
+    if (x_last > GRID_X + GRID_W - 2) x_last = GRID_X + GRID_W - 2;
     
-    // Vertical grid line?
-    if (col > 0 && col % div_w == 0 && x != cx) {
-        for (int y = GRID_Y; y < GRID_Y + GRID_H; y += 5) {
-            vga_draw_pixel(x, y, COLOR_GRID);
+    int have_prev = 0;
+    int prev_top = 0, prev_bottom = 0;
+    for (int x = x_first; x <= x_last; x++) {
+        if (mins[x] > maxs[x]) {
+            have_prev = 0;
+            continue;
         }
-    }
-    
-    // Horizontal grid lines
-    for (int i = 1; i < DIV_Y; i++) {
-        int gy = GRID_Y + i * div_h;
-        if ((x - GRID_X) % 5 == 0) {
-            vga_draw_pixel(x, gy, COLOR_GRID);
+        int y_top = adc_to_y(maxs[x]);
+        int y_bottom = adc_to_y(mins[x]);
+        int top = y_top, bottom = y_bottom;
+        if (have_prev) {
+            if (top > prev_bottom + 1) top = prev_bottom + 1;
+            if (bottom < prev_top - 1) bottom = prev_top - 1;
         }
+        for (int row = top; row <= bottom; row++) {
+            put_pixel(x, row, color);
+        }
+        have_prev = 1;
+        prev_top = y_top;
+        prev_bottom = y_bottom;
     }
-    
-    // Center horizontal line
-    if ((x - GRID_X) % 3 == 0) {
-        vga_draw_pixel(x, cy, COLOR_GRID_BRIGHT);
-    }
-    
-    // Center vertical line
-    if (x == cx) {
-        for (int y = GRID_Y; y < GRID_Y + GRID_H; y += 3) {
-            vga_draw_pixel(x, y, COLOR_GRID_BRIGHT);
+}
+
+/**
+ * Paint the waveform area from per-pixel counts, column-major and
+ * VGA_WAVEFORM_HEIGHT per column: ramp[count] where the count is
+ * nonzero, the graticule where it is zero. One pass over the area, like
+ * vga_draw_grid().
+ */
+void vga_draw_intensity(const uint8_t *counts, const uint8_t *ramp) {
+    for (int x = 0; x < VGA_WAVEFORM_WIDTH; x++) {
+        const uint8_t *col = graticule[x + 1] + 1;
+        for (int y = 0; y < VGA_WAVEFORM_HEIGHT; y++) {
+            uint8_t c = *counts++;
+            put_pixel(GRID_X + 1 + x, GRID_Y + 1 + y, c ? ramp[c] : col[y]);
         }
     }
+}
+
+/**
+ * Restore one column of the waveform area from the graticule image
+ */
+void vga_erase_column(int x) {
+    if (x < GRID_X + 1 || x > GRID_X + GRID_W - 2) return;
     
-    // Ticks on center line
-    int minor = div_w / 5;
-    if (col % div_w == 0) {
-        vline(x, cy - 3, cy + 3, COLOR_GRID_BRIGHT);
-    } else if (col % minor == 0) {
-        vline(x, cy - 1, cy + 1, COLOR_GRID_BRIGHT);
+    const uint8_t *col = graticule[x - GRID_X];
+    for (int y = GRID_Y + 1; y <= GRID_Y + GRID_H - 2; y++) {
+        put_pixel(x, y, col[y - GRID_Y]);
     }
 }
 
+/**
+ * Restore one pixel of the waveform area from the graticule image
+ */
+void vga_erase_pixel(int x, int y) {
+    if (x < GRID_X + 1 || x > GRID_X + GRID_W - 2) return;
+    if (y < GRID_Y + 1 || y > GRID_Y + GRID_H - 2) return;
+    put_pixel(x, y, graticule[x - GRID_X][y - GRID_Y]);
+}
+
 int vga_adc_to_screen_y(uint16_t adc_value) {
-    int y = GRID_Y + GRID_H - 1 - (int)((uint32_t)adc_value * (GRID_H - 2) / 65535);
-    if (y < GRID_Y + 1) y = GRID_Y + 1;
-    if (y > GRID_Y + GRID_H - 2) y = GRID_Y + GRID_H - 2;
-    return y;
+    return adc_to_y(adc_value);
+}
+
+/**
+ * Screen position of an XY point: y_adc up the waveform area as for a
+ * trace, x_adc across it at the same pixels per code, centred, so both
+ * axes share the V/div and a circle stays round
+ */
+void vga_xy_to_screen(uint16_t x_adc, uint16_t y_adc, int *x, int *y) {
+    *x = GRID_X + GRID_W / 2 + ((int32_t)x_adc - 32768) * (GRID_H - 2) / 65535;
+    *y = adc_to_y(y_adc);
 }
 
 void vga_get_waveform_bounds(int *top, int *bottom, int *left, int *right) {
@@ -521,38 +903,191 @@ void vga_get_waveform_bounds(int *top, int *bottom, int *left, int *right) {
 // ============================================================================
 
 void vga_scope_init(void) {
+    build_graticule();
+    vga_begin_frame();
     vga_clear_screen(COLOR_BLACK);
     vga_draw_header();
     vga_draw_grid();
     vga_draw_footer();
+    vga_present();
 }
 
-void vga_scope_update_info(uint8_t channel, float voltage, float v_per_div,
-                           float time_per_div, float v_max, float v_min) {
+/**
+ * Update the footer readouts. Voltages in microvolts, the vertical scale
+ * in millivolts per division and the timebase in microseconds per
+ * division.
+ */
+void vga_scope_update_info_fixed(uint8_t channel, int32_t uv, int32_t mv_per_div,
+                                 int32_t us_per_div, int32_t max_uv, int32_t min_uv) {
+    (void)uv;
     if (channel == 1) {
-        scope.ch1_vdiv = v_per_div;
-        scope.ch1_pkpk = v_max - v_min;
+        scope.ch1_vdiv_mv = mv_per_div;
+        scope.ch1_meas_uv = max_uv - min_uv;
     } else {
-        scope.ch2_vdiv = v_per_div;
-        scope.ch2_pkpk = v_max - v_min;
+        scope.ch2_vdiv_mv = mv_per_div;
+        scope.ch2_meas_uv = max_uv - min_uv;
     }
-    scope.time_div = time_per_div;
+    scope.time_div_us = us_per_div;
+    scope.meas_label = "Pk:";
     
-    // Redraw footer with new values
-    vga_draw_footer();
+    // Redraw footer with new values; composed frames pick them up anyway
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_footer();
+}
+
+/**
+ * Show a measurement in place of the peak-to-peak readout: a label of up
+ * to 3 characters, shared by both channels and the math trace (channel
+ * 3), and the value in microvolts
+ */
+void vga_scope_set_measurement(uint8_t channel, const char *label, int32_t uv) {
+    int32_t *value = channel == 1 ? &scope.ch1_meas_uv :
+                     channel == 2 ? &scope.ch2_meas_uv : &scope.math_meas_uv;
+    if (label == scope.meas_label && uv == *value) return;
+    scope.meas_label = label;
+    *value = uv;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_footer();
 }
 
+/**
+ * Float wrapper around vga_scope_update_info_fixed(), volts and ms
+ */
+void vga_scope_update_info(uint8_t channel, float voltage, float v_per_div,
+                           float time_per_div, float v_max, float v_min) {
+    vga_scope_update_info_fixed(channel, (int32_t)(voltage * 1e6f),
+                                (int32_t)(v_per_div * 1e3f + 0.5f),
+                                (int32_t)(time_per_div * 1e3f + 0.5f),
+                                (int32_t)(v_max * 1e6f), (int32_t)(v_min * 1e6f));
+}
+
+/**
+ * Set the trigger level shown by vga_draw_trigger_marker()
+ */
 void vga_scope_set_trigger(uint16_t level) {
-    scope.triggered = 1;
+    scope.trig_level = level;
+}
+
+/**
+ * Set the header's trigger indicator, one of TRIG_STATUS_*
+ */
+void vga_scope_set_trigger_status(int status) {
+    if (status == scope.triggered) return;
+    scope.triggered = status;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
+}
+
+/**
+ * Small arrow at the right edge of the waveform area pointing at the
+ * trigger level. Draw it after the trace, which may have covered it.
+ */
+void vga_draw_trigger_marker(void) {
+    int x = GRID_X + GRID_W - 2;
+    int y = adc_to_y(scope.trig_level);
+    for (int i = 0; i < 3; i++) {
+        int top = y - i, bottom = y + i;
+        if (top < GRID_Y + 1) top = GRID_Y + 1;
+        if (bottom > GRID_Y + GRID_H - 2) bottom = GRID_Y + GRID_H - 2;
+        vline(x - i, top, bottom, COLOR_GREEN);
+    }
+}
+
+/**
+ * Set the time/div readout, microseconds
+ */
+void vga_scope_set_timebase(int32_t us_per_div) {
+    if (us_per_div == scope.time_div_us) return;
+    scope.time_div_us = us_per_div;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_footer();
+}
+
+/**
+ * Set the CH1 frequency (mHz) and duty cycle (per mille) readouts,
+ * freq_mhz 0 shows no measurement
+ */
+void vga_scope_set_frequency_fixed(int32_t freq_mhz, int32_t duty_permille) {
+    if (freq_mhz == scope.freq_mhz && duty_permille == scope.duty_permille) return;
+    scope.freq_mhz = freq_mhz;
+    scope.duty_permille = duty_permille;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_footer();
 }
 
+/**
+ * Float wrapper around vga_scope_set_frequency_fixed(), Hz
+ */
 void vga_scope_set_frequency(float freq) {
-    // Could display frequency
+    vga_scope_set_frequency_fixed((int32_t)(freq * 1e3f + 0.5f), scope.duty_permille);
 }
 
 void vga_scope_set_running(uint8_t running) {
     scope.running = running;
-    vga_draw_header();
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
+}
+
+/**
+ * Set the header's source indicator, one of VGA_SOURCE_*, with the
+ * replay speed in times real time
+ */
+void vga_scope_set_source(int source, int speed) {
+    if (source == scope.source && speed == scope.replay_speed) return;
+    scope.source = source;
+    scope.replay_speed = speed;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
+}
+
+/**
+ * Set the acquisition mode readout, sweeps is the averaging depth
+ */
+void vga_scope_set_acquire(int mode, int sweeps) {
+    if (mode == scope.acquire && sweeps == scope.avg_sweeps) return;
+    scope.acquire = mode;
+    scope.avg_sweeps = sweeps;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
+}
+
+/**
+ * Show the spectrum readouts: FFT size and window in the header, dB/div
+ * and mHz/div in the footer. points 0 goes back to the time-domain ones.
+ */
+void vga_scope_set_spectrum(int points, const char *window, int32_t mhz_per_div) {
+    if (points == scope.fft_points && window == scope.fft_window &&
+        mhz_per_div == scope.fft_mhz_div) return;
+    scope.fft_points = points;
+    scope.fft_window = window;
+    scope.fft_mhz_div = mhz_per_div;
+    if (render_mode == VGA_MODE_INCREMENTAL) {
+        vga_draw_header();
+        vga_draw_footer();
+    }
+}
+
+/**
+ * Set the header's CH1 filter indicator, up to 3 characters
+ */
+void vga_scope_set_filter(const char *name) {
+    if (name == scope.filter) return;
+    scope.filter = name;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
+}
+
+/**
+ * Show the math function in the footer in place of the coupling and ADC
+ * readouts, "" for none, with the trace's V/div when it is in volts
+ */
+void vga_scope_set_math(const char *name, int32_t vdiv_mv) {
+    if (name == scope.math && vdiv_mv == scope.math_vdiv_mv) return;
+    scope.math = name;
+    scope.math_vdiv_mv = vdiv_mv;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_footer();
+}
+
+/**
+ * Show the XY readout in the header in place of the acquisition mode:
+ * the trail length in points, 0 for infinite persistence
+ */
+void vga_scope_set_xy(int on, int trail) {
+    if (on == scope.xy && trail == scope.xy_trail) return;
+    scope.xy = on;
+    scope.xy_trail = trail;
+    if (render_mode == VGA_MODE_INCREMENTAL) vga_draw_header();
 }
 
 void vga_scope_set_channel(int ch, int enabled) {
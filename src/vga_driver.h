@@ -12,9 +12,50 @@
 #define SCREEN_WIDTH    320
 #define SCREEN_HEIGHT   240
 
-// VGA buffer
+// VGA buffer: two frames back to back, the DMA controller scans out one
 #define VGA_PIXEL_BUFFER_BASE   0x08000000
-#define pVGA_PIXEL_BUFFER       ((volatile uint16_t *) VGA_PIXEL_BUFFER_BASE)
+#define VGA_FRAME_BYTES         (SCREEN_WIDTH * SCREEN_HEIGHT * 2)
+#define VGA_BACK_BUFFER_BASE    (VGA_PIXEL_BUFFER_BASE + VGA_FRAME_BYTES)
+
+// Pixel buffer DMA controller
+#define VGA_DMA_BASE            0x04000100
+#define VGA_DMA_BUFFER          (VGA_DMA_BASE + 0)   // Front buffer; any write requests a swap
+#define VGA_DMA_BACK_BUFFER     (VGA_DMA_BASE + 4)
+#define VGA_DMA_RESOLUTION      (VGA_DMA_BASE + 8)
+#define VGA_DMA_STATUS          (VGA_DMA_BASE + 12)
+#define VGA_DMA_STATUS_SWAP     0x1                  // S: swap waits for end of frame
+
+// Render modes
+#define VGA_MODE_INCREMENTAL    0   // Draw into the visible frame as samples arrive
+#define VGA_MODE_DOUBLE_BUFFER  1   // Compose whole frames off screen, swap on vsync
+
+// Signal source shown in the header
+#define VGA_SOURCE_LIVE         0
+#define VGA_SOURCE_RECORDING    1   // Live, and being recorded
+#define VGA_SOURCE_REPLAY       2
+
+// Acquisition mode shown in the header
+#define VGA_ACQ_NORMAL          0
+#define VGA_ACQ_AVERAGE         1   // Average across sweeps
+#define VGA_ACQ_ENVELOPE        2   // Min/max across sweeps
+#define VGA_ACQ_HIRES           3   // Mean of the samples in each column
+
+// Vertical scale of the spectrum display, 0 dBFS at the top
+#define VGA_SPECTRUM_DB_PER_DIV 10
+
+// Graticule divisions across and down the waveform area
+#define VGA_GRID_DIV_X          10
+#define VGA_GRID_DIV_Y          8
+
+// Waveform area inside the grid border, see vga_get_waveform_bounds()
+#define VGA_WAVEFORM_WIDTH      318
+#define VGA_WAVEFORM_HEIGHT     198
+
+// Compose in a RAM shadow framebuffer and copy only the dirty spans to
+// the pixel buffer on vga_flush(). Set to 0 to draw straight to VGA memory.
+#ifndef VGA_SHADOW_FRAMEBUFFER
+#define VGA_SHADOW_FRAMEBUFFER  1
+#endif
 
 
 // --- VGA Color Definitions (8-bit RGB 3-3-2 format) ---
@@ -37,7 +78,35 @@
 #define COLOR_GRID          0x24
 #define COLOR_GRID_BRIGHT   0x49    // Brighter for major lines
 #define COLOR_GRAY          0x92    // Dim text
+#define COLOR_WAVEFORM      COLOR_YELLOW    // CH1 trace, matches the footer
+#define COLOR_WAVEFORM2     COLOR_CYAN      // CH2 trace
+#define COLOR_MATH          COLOR_MAGENTA   // Math trace
+#define COLOR_XY            COLOR_GREEN     // XY display, newer points
+#define COLOR_XY_DIM        0x0C            // 0b000 011 00, older points
+
+
+// Per-frame timing in double-buffered mode, in CPU cycles
+typedef struct {
+    uint32_t frames;            // Frames presented
+    uint32_t compose_cycles;    // vga_begin_frame() to swap request, total
+    uint32_t compose_max;
+    uint32_t swap_cycles;       // Swap request to swap done, total
+    uint32_t swap_max;
+} vga_frame_stats_t;
+
+// Shadow framebuffer
+void vga_flush(void);
+void vga_invalidate(void);
+uint32_t vga_get_flush_words(void);
 
+// Render mode and frame presentation
+void vga_set_render_mode(uint8_t mode);
+uint8_t vga_get_render_mode(void);
+void vga_begin_frame(void);
+void vga_present(void);
+int vga_swap_pending(void);
+void vga_get_frame_stats(vga_frame_stats_t *stats);
+void vga_reset_frame_stats(void);
 
 // Basic drawing
 void vga_clear_screen(uint16_t color);
@@ -58,16 +127,33 @@ void vga_draw_footer(void);
 void vga_scope_init(void);
 
 void vga_clear_waveform_area(void);
-void vga_draw_waveform_segment(int x1, uint16_t y1_adc, int x2, uint16_t y2_adc, uint16_t color);
+void vga_draw_envelope(const uint16_t *mins, const uint16_t *maxs,
+                       int x_first, int x_last, uint16_t color);
+void vga_draw_intensity(const uint8_t *counts, const uint8_t *ramp);
 void vga_erase_column(int x);
+void vga_erase_pixel(int x, int y);
 int vga_adc_to_screen_y(uint16_t adc_value);
+void vga_xy_to_screen(uint16_t x_adc, uint16_t y_adc, int *x, int *y);
 void vga_get_waveform_bounds(int *top, int *bottom, int *left, int *right);
 
+void vga_scope_update_info_fixed(uint8_t channel, int32_t uv, int32_t mv_per_div,
+                                 int32_t us_per_div, int32_t max_uv, int32_t min_uv);
+void vga_scope_set_measurement(uint8_t channel, const char *label, int32_t uv);
 void vga_scope_update_info(uint8_t channel, float voltage, float v_per_div,
                            float time_per_div, float v_max, float v_min);
 void vga_scope_set_trigger(uint16_t level);
+void vga_scope_set_trigger_status(int status);
+void vga_draw_trigger_marker(void);
+void vga_scope_set_timebase(int32_t us_per_div);
+void vga_scope_set_frequency_fixed(int32_t freq_mhz, int32_t duty_permille);
 void vga_scope_set_frequency(float freq);
 void vga_scope_set_running(uint8_t running);
+void vga_scope_set_source(int source, int speed);
+void vga_scope_set_acquire(int mode, int sweeps);
+void vga_scope_set_spectrum(int points, const char *window, int32_t mhz_per_div);
+void vga_scope_set_filter(const char *name);
+void vga_scope_set_math(const char *name, int32_t vdiv_mv);
+void vga_scope_set_xy(int on, int trail);
 void vga_scope_set_channel(int ch, int enabled);
 
 int abs(int n);
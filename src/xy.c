@@ -0,0 +1,113 @@
+/**
+ * xy.c - XY display of CH1 against CH2
+ *
+ * Point n sits in ring slot n % XY_RING. The owner map holds slot + 1
+ * of the point that last drew each pixel, 0 for none. A slot is only
+ * reused after its point has gone through every step of the trail, and
+ * a point only ever checks the entry under itself, so an entry left
+ * naming a reused slot (persistence erases nothing) is never acted on.
+ */
+
+#include "xy.h"
+
+#define RING_MASK           (XY_RING - 1)
+
+#if XY_RING & RING_MASK
+#error "XY_RING must be a power of two"
+#endif
+
+// Screen position of a point
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+} point_t;
+
+static point_t ring[XY_RING];
+static uint16_t owner[VGA_WAVEFORM_WIDTH][VGA_WAVEFORM_HEIGHT];
+static uint32_t added;              // Points since the reset
+static int trail;                   // Points on screen, or bright with persistence
+static bool persist;
+static uint32_t writes;             // Pixels drawn or restored, total
+
+static int top_row;                 // Screen row of owner row 0
+static int left_col;                // Screen column of owner column 0
+
+/**
+ * Forget every point; the caller clears the waveform area. trail is
+ * clamped to XY_TRAIL_MIN..XY_RING.
+ */
+void xy_reset(int t, bool p) {
+    trail = t < XY_TRAIL_MIN ? XY_TRAIL_MIN : t > XY_RING ? XY_RING : t;
+    persist = p;
+    added = 0;
+    for (int x = 0; x < VGA_WAVEFORM_WIDTH; x++) {
+        for (int y = 0; y < VGA_WAVEFORM_HEIGHT; y++) owner[x][y] = 0;
+    }
+    vga_get_waveform_bounds(&top_row, 0, &left_col, 0);
+}
+
+static inline uint16_t *owner_of(const point_t *p) {
+    return &owner[p->x - left_col][p->y - top_row];
+}
+
+/**
+ * Recolour point n, or with erase restore the graticule under it, if its
+ * pixel still shows it
+ */
+static void repaint(uint32_t n, uint16_t color, bool erase) {
+    point_t *p = &ring[n & RING_MASK];
+    uint16_t *o = owner_of(p);
+    if (*o != (n & RING_MASK) + 1) return;
+    if (erase) {
+        *o = 0;
+        vga_erase_pixel(p->x, p->y);
+    } else {
+        vga_draw_pixel(p->x, p->y, color);
+    }
+    writes++;
+}
+
+/**
+ * Add the point (ch1, ch2), drawing it at once in incremental mode
+ */
+void xy_add(uint16_t ch1, uint16_t ch2) {
+    bool draw = vga_get_render_mode() == VGA_MODE_INCREMENTAL;
+    uint32_t n = added++;
+
+    // Age the trail first: the point erased may be in the slot reused
+    if (draw && n >= (uint32_t)trail / 2) repaint(n - trail / 2, COLOR_XY_DIM, false);
+    if (draw && !persist && n >= (uint32_t)trail) repaint(n - trail, 0, true);
+
+    int x, y;
+    point_t *p = &ring[n & RING_MASK];
+    vga_xy_to_screen(ch1, ch2, &x, &y);
+    p->x = (uint16_t)x;
+    p->y = (uint16_t)y;
+    *owner_of(p) = (n & RING_MASK) + 1;
+    if (draw) {
+        vga_draw_pixel(x, y, COLOR_XY);
+        writes++;
+    }
+}
+
+/**
+ * Paint the points held, oldest first: the trail, or the whole ring with
+ * persistence. For a composed frame or a redraw of the waveform area.
+ */
+void xy_draw(void) {
+    uint32_t held = persist ? XY_RING : (uint32_t)trail;
+    if (held > added) held = added;
+
+    for (uint32_t n = added - held; n < added; n++) {
+        const point_t *p = &ring[n & RING_MASK];
+        vga_draw_pixel(p->x, p->y, added - n > (uint32_t)trail / 2 ? COLOR_XY_DIM : COLOR_XY);
+    }
+    writes += held;
+}
+
+/**
+ * Pixels drawn or restored since the start, for the cost per point
+ */
+uint32_t xy_pixel_writes(void) {
+    return writes;
+}
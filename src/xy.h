@@ -0,0 +1,36 @@
+/**
+ * xy.h - XY display of CH1 against CH2
+ *
+ * Every CH1 sample and the CH2 sample held against it make one point,
+ * CH1 across and CH2 up. The newest XY_RING points are kept in a ring.
+ * A point is drawn bright, turns dim once half the trail is newer, and
+ * is erased when it falls off the end of the trail, so each new point
+ * costs one pixel drawn, one recoloured and one restored, however long
+ * the trail. With persistence nothing is erased and the trail only sets
+ * when points dim.
+ *
+ * Points that land on the same pixel are told apart by a map of which
+ * point drew each pixel last: an old point only dims or erases a pixel
+ * still showing it, so a newer point there stays as it is.
+ *
+ * In double-buffered mode xy_add() only keeps the ring and xy_draw()
+ * paints the points held into each composed frame.
+ */
+
+#ifndef XY_H
+#define XY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vga_driver.h"
+
+// Points held, the longest trail (XY_TRAIL_MIN << 3)
+#define XY_RING             1024
+#define XY_TRAIL_MIN        128
+
+void xy_reset(int trail, bool persist);
+void xy_add(uint16_t ch1, uint16_t ch2);
+void xy_draw(void);
+uint32_t xy_pixel_writes(void);
+
+#endif // XY_H